@@ -0,0 +1,158 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#include "accessibleeventqueue.h"
+
+#include "accessiblepieview.h"
+
+#include <QAbstractItemView>
+#include <QDebug>
+
+#include <algorithm>
+
+AccessibleEventQueue::AccessibleEventQueue(QAbstractItemView *view)
+: QObject(view)
+, view(view)
+{
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(0);
+    connect(&flushTimer, &QTimer::timeout, this, &AccessibleEventQueue::flush);
+}
+
+void AccessibleEventQueue::post(QAccessible::Event type, const QModelIndex &index)
+{
+    ++counts.posted;
+    flushTimer.start();
+
+    const bool isFocus = type == QAccessible::Focus;
+    if (!isFocus && selectionWithin)
+        return;
+
+    // Drop the event this one supersedes, if any.
+    for (int i = 0; i < events.size(); ++i) {
+        const Event &event = events.at(i);
+        const bool eventIsFocus = event.type == QAccessible::Focus;
+        if (eventIsFocus == isFocus && (isFocus || event.index == index)) {
+            if (!isFocus)
+                --selectionEvents;
+            events.remove(i);
+            break;
+        }
+    }
+
+    if (!isFocus && ++selectionEvents > MaxSelectionEvents) {
+        collapseSelection();
+        return;
+    }
+    events.append({type, index});
+}
+
+void AccessibleEventQueue::postSelectionWithin()
+{
+    ++counts.posted;
+    flushTimer.start();
+    collapseSelection();
+}
+
+void AccessibleEventQueue::collapseSelection()
+{
+    selectionWithin = true;
+    events.erase(std::remove_if(events.begin(), events.end(), [](const Event &event) {
+        return event.type != QAccessible::Focus;
+    }), events.end());
+    selectionEvents = 0;
+}
+
+void AccessibleEventQueue::flush()
+{
+    flushTimer.stop();
+    const qint64 sentBefore = counts.sent;
+
+    if (selectionWithin)
+        send(QAccessible::SelectionWithin, -1);
+
+    // In grouped mode the children of the view are groups rather than items,
+    // so the events name the interfaces of the items instead.
+    AccessiblePieView *grouped = nullptr;
+    if (!events.isEmpty()) {
+        grouped = dynamic_cast<AccessiblePieView*>(QAccessible::queryAccessibleInterface(view));
+        if (grouped && !grouped->isGrouped())
+            grouped = nullptr;
+    }
+
+    // Items may have moved or gone since their events were posted.
+    for (const Event &event : qAsConst(events)) {
+        if (event.index.isValid() && event.index.model() == view->model()) {
+            const int child = event.index.row() * view->model()->columnCount()
+                + event.index.column();
+            send(event.type, child, grouped ? grouped->child(event.index) : nullptr);
+        }
+    }
+
+    events.clear();
+    selectionEvents = 0;
+    selectionWithin = false;
+
+#if !defined(NDEBUG)
+    if (counts.sent != sentBefore)
+        qDebug() << "Accessibility events for" << view->metaObject()->className()
+            << "sent" << counts.sent << "of" << counts.posted << "posted";
+#else
+    Q_UNUSED(sentBefore)
+#endif
+}
+
+void AccessibleEventQueue::send(QAccessible::Event type, int child, QAccessibleInterface *item)
+{
+#if !defined(NDEBUG)
+    const char *name = type == QAccessible::Focus ? "Focus"
+        : type == QAccessible::SelectionAdd ? "Selected"
+        : type == QAccessible::SelectionRemove ? "Deselected"
+        : "Selection changed within";
+    qDebug() << "Creating accessibility event for" << view->metaObject()->className()
+        << ":" << name << "child" << child;
+    // Note: if crashes do happen, they are likely to occur in Qt or screen reader code that
+    // is outside our control. It might not be obvious that the crash was caused by our code,
+    // or even that is was related to accessibility, hence the need to print a debug
+    // statement before creating the event and calling updateAccessibility(). Release builds
+    // send too many events to log each one, see --accessible-event-stats instead.
+#endif
+    if (item) {
+        QAccessibleEvent event(item, type);
+        QAccessible::updateAccessibility(&event);
+    } else {
+        QAccessibleEvent event(view, type);
+        if (child >= 0)
+            event.setChild(child);
+        QAccessible::updateAccessibility(&event);
+    }
+    ++counts.sent;
+}
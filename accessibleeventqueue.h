@@ -0,0 +1,92 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#ifndef ACCESSIBLEEVENTQUEUE_H
+#define ACCESSIBLEEVENTQUEUE_H
+
+#include <QAccessible>
+#include <QObject>
+#include <QPersistentModelIndex>
+#include <QTimer>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QAbstractItemView;
+QT_END_NAMESPACE
+
+// Collects the accessibility events of an item view and sends them on the
+// next turn of the event loop. Only the last Focus event and the last
+// selection event for each item are kept, and a burst of selection events
+// is sent as a single SelectionWithin event for the whole view.
+class AccessibleEventQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    AccessibleEventQueue(QAbstractItemView *view);
+
+    // Queues a Focus, SelectionAdd or SelectionRemove event for the item.
+    void post(QAccessible::Event type, const QModelIndex &index);
+    // Queues a SelectionWithin event, which replaces any queued events for
+    // the selection of individual items.
+    void postSelectionWithin();
+
+    // Events posted and actually sent so far, reported on exit by the
+    // --accessible-event-stats option.
+    struct Stats {
+        qint64 posted = 0;
+        qint64 sent = 0;
+    };
+    Stats stats() const { return counts; }
+
+    // More selection events than this in one turn become SelectionWithin.
+    static constexpr int MaxSelectionEvents = 16;
+
+public slots:
+    void flush();
+
+private:
+    struct Event {
+        QAccessible::Event type;
+        QPersistentModelIndex index;
+    };
+    void collapseSelection();
+    void send(QAccessible::Event type, int child, QAccessibleInterface *item = nullptr);
+
+    QAbstractItemView *view;
+    QVector<Event> events;
+    int selectionEvents = 0;
+    bool selectionWithin = false;
+    QTimer flushTimer;
+    Stats counts;
+};
+
+#endif // ACCESSIBLEEVENTQUEUE_H
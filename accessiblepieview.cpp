@@ -31,12 +31,86 @@
 
 #include "accessiblepieview.h"
 
-#include "piemodel.h"
 #include "pieview.h"
 
 #define ROWS m_pieview->model()->rowCount()
 #define COLS m_pieview->model()->columnCount()
 
+namespace {
+
+// Hands out fixed-size slots carved from chunks. Freed slots go on a list to
+// be reused, so walking a large chart costs one allocation per chunk rather
+// than one per item. Only used from the GUI thread, like the items.
+class ItemPool
+{
+public:
+    void* allocate()
+    {
+        Slot* slot = m_free;
+        if (slot) {
+            m_free = slot->next;
+            ++m_stats.recycled;
+        } else {
+            if (m_unused == 0)
+                grow();
+            slot = &m_chunks.last()[ChunkSize - m_unused--];
+        }
+        ++m_stats.live;
+        ++m_stats.allocations;
+        return slot;
+    }
+
+    void deallocate(void* p)
+    {
+        Slot* slot = static_cast<Slot*>(p);
+        slot->next = m_free;
+        m_free = slot;
+        --m_stats.live;
+    }
+
+    // Returns the chunks to the heap, but only once no item is using them.
+    void trim()
+    {
+        if (m_stats.live != 0)
+            return;
+        for (Slot* chunk : qAsConst(m_chunks))
+            delete[] chunk;
+        m_chunks.clear();
+        m_free = nullptr;
+        m_unused = 0;
+        m_stats.capacity = 0;
+    }
+
+    const AccessiblePieItem::PoolStats& stats() const { return m_stats; }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(AccessiblePieItem) char storage[sizeof(AccessiblePieItem)];
+    };
+    static constexpr int ChunkSize = 1024;
+
+    void grow()
+    {
+        m_chunks.append(new Slot[ChunkSize]);
+        m_unused = ChunkSize;
+        m_stats.capacity += ChunkSize;
+    }
+
+    QVector<Slot*> m_chunks;
+    Slot* m_free = nullptr; // slots freed by deleted items
+    int m_unused = 0;       // slots at the end of the last chunk never used
+    AccessiblePieItem::PoolStats m_stats;
+};
+
+ItemPool& itemPool()
+{
+    static ItemPool pool;
+    return pool;
+}
+
+} // namespace
+
 QAccessibleInterface* accessiblePieViewFactory(const QString &classname, QObject *object)
 {
     if (object && object->isWidgetType() && classname == QLatin1String("PieView"))
@@ -52,6 +126,32 @@ AccessiblePieItem::AccessiblePieItem(PieView* pv, QModelIndex index)
     m_index = index;
 }
 
+void* AccessiblePieItem::operator new(size_t size)
+{
+    if (size != sizeof(AccessiblePieItem))
+        return ::operator new(size); // a subclass
+    return itemPool().allocate();
+}
+
+void AccessiblePieItem::operator delete(void* p, size_t size)
+{
+    if (!p)
+        return;
+    if (size != sizeof(AccessiblePieItem))
+        return ::operator delete(p);
+    itemPool().deallocate(p);
+}
+
+AccessiblePieItem::PoolStats AccessiblePieItem::poolStats()
+{
+    return itemPool().stats();
+}
+
+void AccessiblePieItem::trimPool()
+{
+    itemPool().trim();
+}
+
 QAccessibleInterface* AccessiblePieItem::child(int index) const
 {
     Q_UNUSED(index)
@@ -70,9 +170,14 @@ int AccessiblePieItem::childCount() const
     return 0;
 }
 
+// Returns the index of the item among the children of its parent, which in
+// grouped mode is the group rather than the view.
 int AccessiblePieItem::index() const
 {
-    return m_index.row() * COLS + m_index.column();
+    int row = m_index.row();
+    if (m_pieview->accessibleGroupSize() > 0)
+        row %= m_pieview->accessibleGroupSize();
+    return row * COLS + m_index.column();
 }
 
 QAccessibleInterface* AccessiblePieItem::focusChild() const
@@ -89,13 +194,17 @@ int AccessiblePieItem::indexOfChild(const QAccessibleInterface*) const
 
 bool AccessiblePieItem::isValid() const
 {
-    return m_pieview != nullptr
-        && m_index.isValid()
-        && m_index.data(AccessibleInterfaceRole).value<AccessiblePieItem*>() == this;
+    return m_pieview != nullptr && m_index.isValid();
 }
 
 QString AccessiblePieItem::name() const
 {
+    // Screen readers ask for the name over and over while the user navigates,
+    // so return the cached one (a shared copy, no allocation) when possible.
+    const double total = m_pieview->total();
+    if (m_nameValid && m_nameTotal == total)
+        return m_name;
+
     QModelIndex categoryIndex = m_index.sibling(m_index.row(), 0);
     QModelIndex sliceIndex    = m_index.sibling(m_index.row(), 1);
 
@@ -103,7 +212,7 @@ QString AccessiblePieItem::name() const
     double sliceValue    = sliceIndex.data().toDouble();    // e.g. "21"
 
     // convert value to percentage since this is a pie chart
-    double percentage = sliceValue / m_pieview->total() * 100.0;
+    double percentage = sliceValue / total * 100.0;
     QString slicePercentage = QLocale::system().toString(percentage, 'f', 1);
 
     // Ensure the returned name includes both the categoryName and the
@@ -130,6 +239,9 @@ QString AccessiblePieItem::name() const
     if (!m_pieview->selectionModel()->isSelected(m_index))
         name = QObject::tr("%1 not selected").arg(name);
 #endif
+    m_name = name;
+    m_nameTotal = total;
+    m_nameValid = true;
     return name;
 }
 
@@ -140,7 +252,11 @@ QObject* AccessiblePieItem::object() const
 
 QAccessibleInterface* AccessiblePieItem::parent() const
 {
-    return QAccessible::queryAccessibleInterface(m_pieview);
+    QAccessibleInterface* view = QAccessible::queryAccessibleInterface(m_pieview);
+    const int groupSize = m_pieview->accessibleGroupSize();
+    if (groupSize > 0 && m_index.isValid())
+        return static_cast<AccessiblePieView*>(view)->group(m_index.row() / groupSize);
+    return view;
 }
 
 QRect AccessiblePieItem::rect() const
@@ -274,6 +390,121 @@ void AccessiblePieItem::setText(QAccessible::Text t, const QString &text)
     }
 }
 
+AccessiblePieGroup::AccessiblePieGroup(PieView* pv, int group)
+: QAccessibleInterface()
+{
+    m_pieview = pv;
+    m_group = group;
+}
+
+int AccessiblePieGroup::firstRow() const
+{
+    return m_group * m_pieview->accessibleGroupSize();
+}
+
+int AccessiblePieGroup::lastRow() const
+{
+    return qMin(firstRow() + m_pieview->accessibleGroupSize(), ROWS) - 1;
+}
+
+QAccessibleInterface* AccessiblePieGroup::child(int index) const
+{
+    Q_ASSERT(0 <= index && index < childCount());
+    QModelIndex modelIndex = m_pieview->model()->index(firstRow() + index / COLS, index % COLS);
+    return static_cast<AccessiblePieView*>(parent())->child(modelIndex);
+}
+
+QAccessibleInterface* AccessiblePieGroup::childAt(int x, int y) const
+{
+    QModelIndex index = m_pieview->indexAt(m_pieview->mapFromGlobal(QPoint(x, y)));
+    if (index.isValid() && firstRow() <= index.row() && index.row() <= lastRow())
+        return static_cast<AccessiblePieView*>(parent())->child(index);
+    return nullptr; // no child at (x,y)
+}
+
+int AccessiblePieGroup::childCount() const
+{
+    return qMax(0, lastRow() - firstRow() + 1) * COLS;
+}
+
+QAccessibleInterface* AccessiblePieGroup::focusChild() const
+{
+    QModelIndex current = m_pieview->currentIndex();
+    if (current.isValid() && firstRow() <= current.row() && current.row() <= lastRow())
+        return static_cast<AccessiblePieView*>(parent())->child(current);
+    return nullptr;
+}
+
+int AccessiblePieGroup::indexOfChild(const QAccessibleInterface* iface) const
+{
+    Q_ASSERT(iface && iface->isValid() && iface->parent() == this);
+    Q_ASSERT(dynamic_cast<const AccessiblePieItem*>(iface) != nullptr);
+    return static_cast<const AccessiblePieItem*>(iface)->index();
+}
+
+bool AccessiblePieGroup::isValid() const
+{
+    return m_pieview != nullptr
+        && m_pieview->accessibleGroupSize() > 0
+        && firstRow() < ROWS;
+}
+
+QObject* AccessiblePieGroup::object() const
+{
+    return nullptr;
+}
+
+QAccessibleInterface* AccessiblePieGroup::parent() const
+{
+    return QAccessible::queryAccessibleInterface(m_pieview);
+}
+
+// The rows of a group can be spread all over the pie, so the group simply
+// covers the whole view.
+QRect AccessiblePieGroup::rect() const
+{
+    return parent()->rect();
+}
+
+QAccessible::Role AccessiblePieGroup::role() const
+{
+    return QAccessible::Grouping;
+}
+
+QAccessible::State AccessiblePieGroup::state() const
+{
+    // Only the items themselves can be focused or selected.
+    QAccessible::State groupState;
+    groupState.expandable = true;
+    groupState.expanded = true;
+    return groupState;
+}
+
+QString AccessiblePieGroup::text(QAccessible::Text t) const
+{
+    QAbstractItemModel* model = m_pieview->model();
+    switch (t) {
+    case QAccessible::Name:
+        // e.g. "Apples to Pears", so that users can tell where to look.
+        return QObject::tr("%1 to %2").arg(model->index(firstRow(), 0).data().toString(),
+                                           model->index(lastRow(), 0).data().toString());
+    case QAccessible::Description:
+        return QObject::tr("Slices %1 to %2 of %3")
+            .arg(firstRow() + 1).arg(lastRow() + 1).arg(ROWS);
+    case QAccessible::Value:
+    case QAccessible::Help:
+    default:
+        return QString();
+    }
+}
+
+void AccessiblePieGroup::setText(QAccessible::Text t, const QString &text)
+{
+    // The name and description are made from the rows in the group.
+    Q_UNUSED(t)
+    Q_UNUSED(text)
+}
+
 AccessiblePieView::AccessiblePieView(PieView* pv)
 : QAccessibleWidget(pv, QAccessible::List, pv->accessibleName())
 // We set role to QAccessible::List but other values are possible, see
@@ -290,24 +521,214 @@ AccessiblePieView::AccessiblePieView(PieView* pv)
     m_pieview = pv;
 }
 
+AccessiblePieView::~AccessiblePieView()
+{
+    clearItems();
+    disconnectModel();
+    AccessiblePieItem::trimPool();
+}
+
 QAccessibleInterface* AccessiblePieView::child(QModelIndex index) const
 {
     Q_ASSERT(index.isValid() && index.model() == m_pieview->model());
-    auto iface = index.data(AccessibleInterfaceRole).value<AccessiblePieItem*>();
-    if (!iface) {
-        iface = new AccessiblePieItem(m_pieview, index);
-        m_pieview->model()->setData(index, QVariant::fromValue(iface), AccessibleInterfaceRole);
-        QAccessible::registerAccessibleInterface(iface);
+    bindModel();
+    const int childIndex = index.row() * COLS + index.column();
+    if (QAccessible::Id id = m_items.value(childIndex)) {
+        if (QAccessibleInterface* iface = QAccessible::accessibleInterface(id))
+            return iface;
     }
+    // Only the child asked for is created. A Focus event or childAt() only
+    // needs one, and in grouped mode items must stay within the group read.
+    auto iface = new AccessiblePieItem(m_pieview, index);
+    m_items.insert(childIndex, QAccessible::registerAccessibleInterface(iface));
     return iface;
 }
 
+// Interfaces outlive the calls that create them, so they must follow their
+// rows around as rows are inserted, removed or rearranged in the model, and
+// their cached names must be dropped when the row or its selection changes.
+void AccessiblePieView::bindModel() const
+{
+    QAbstractItemModel* model = m_pieview->model();
+    QItemSelectionModel* selectionModel = m_pieview->selectionModel();
+    if (model == m_model && selectionModel == m_selectionModel)
+        return;
+
+    if (model == m_model)
+        invalidateNames(0, ROWS - 1);
+    else
+        clearItems();
+    disconnectModel();
+    m_model = model;
+    m_selectionModel = selectionModel;
+    if (!model)
+        return;
+
+    auto reindex = [this]() { reindexItems(0); };
+    auto reindexFrom = [this](const QModelIndex &parent, int first) {
+        reindexItems(parent.isValid() ? 0 : first);
+    };
+    auto clear = [this]() { clearItems(); };
+    m_connections = {
+        QObject::connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, m_pieview,
+            [this](const QModelIndex &parent, int first, int last) {
+                if (!parent.isValid())
+                    removeItems(first, last);
+            }),
+        QObject::connect(model, &QAbstractItemModel::rowsRemoved, m_pieview, reindexFrom),
+        QObject::connect(model, &QAbstractItemModel::rowsInserted, m_pieview, reindexFrom),
+        QObject::connect(model, &QAbstractItemModel::rowsMoved, m_pieview, reindex),
+        QObject::connect(model, &QAbstractItemModel::layoutChanged, m_pieview, reindex),
+        QObject::connect(model, &QAbstractItemModel::columnsAboutToBeInserted, m_pieview, clear),
+        QObject::connect(model, &QAbstractItemModel::columnsAboutToBeRemoved, m_pieview, clear),
+        QObject::connect(model, &QAbstractItemModel::modelAboutToBeReset, m_pieview, clear),
+        QObject::connect(model, &QAbstractItemModel::dataChanged, m_pieview,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                if (!topLeft.parent().isValid())
+                    invalidateNames(topLeft.row(), bottomRight.row());
+            }),
+    };
+    if (selectionModel) {
+        auto changed = &QItemSelectionModel::selectionChanged;
+        m_connections.append(QObject::connect(selectionModel, changed, m_pieview,
+            [this](const QItemSelection &selected, const QItemSelection &deselected) {
+                invalidateNames(selected);
+                invalidateNames(deselected);
+            }));
+    }
+}
+
+// Interfaces only exist for the items a screen reader has asked about, which
+// is usually none at all, so the work done here depends on how many there
+// are rather than on how many rows are removed.
+void AccessiblePieView::removeItems(int firstRow, int lastRow) const
+{
+    if (m_items.isEmpty())
+        return;
+
+    if (firstRow == 0 && lastRow == ROWS - 1) {
+        clearItems(); // e.g. clearing the chart, no need to check each item
+        return;
+    }
+
+    // As in invalidateNames(), look up each child in the range or go through
+    // the items, whichever is fewer.
+    const int firstChild = firstRow * COLS;
+    const int endChild = (lastRow + 1) * COLS;
+    if (endChild - firstChild < m_items.size()) {
+        for (int child = firstChild; child < endChild; ++child) {
+            if (QAccessible::Id id = m_items.take(child))
+                QAccessible::deleteAccessibleInterface(id);
+        }
+        return;
+    }
+
+    for (auto it = m_items.begin(); it != m_items.end();) {
+        if (firstChild <= it.key() && it.key() < endChild) {
+            QAccessible::deleteAccessibleInterface(it.value());
+            it = m_items.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// The persistent indexes have already moved, so the child index of each
+// interface can simply be read back from it. Only the items from firstRow
+// onwards can have moved, so the cost is the number of interfaces there,
+// which are kept sorted to find them, rather than the number of rows. Groups
+// are ranges of rows, so they stay put, but those past the end of the model
+// are no longer needed.
+void AccessiblePieView::reindexItems(int firstRow) const
+{
+    for (auto it = m_groups.begin(); it != m_groups.end();) {
+        if (it.key() >= groupCount()) {
+            QAccessible::deleteAccessibleInterface(it.value());
+            it = m_groups.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (m_items.isEmpty())
+        return;
+
+    QVector<QPair<int, QAccessible::Id>> moved;
+    for (auto it = m_items.lowerBound(firstRow * COLS); it != m_items.end();) {
+        const QAccessible::Id id = it.value();
+        it = m_items.erase(it);
+        auto iface = static_cast<AccessiblePieItem*>(QAccessible::accessibleInterface(id));
+        if (!iface)
+            continue;
+        if (iface->m_index.isValid())
+            moved.append({ iface->m_index.row() * COLS + iface->m_index.column(), id });
+        else
+            QAccessible::deleteAccessibleInterface(id);
+    }
+    for (const auto &item : qAsConst(moved))
+        m_items.insert(item.first, item.second);
+}
+
+void AccessiblePieView::clearItems() const
+{
+    for (QAccessible::Id id : qAsConst(m_items))
+        QAccessible::deleteAccessibleInterface(id);
+    m_items.clear();
+    for (QAccessible::Id id : qAsConst(m_groups))
+        QAccessible::deleteAccessibleInterface(id);
+    m_groups.clear();
+}
+
+void AccessiblePieView::invalidateNames(int firstRow, int lastRow) const
+{
+    if (m_items.isEmpty())
+        return;
+
+    auto invalidate = [](QAccessible::Id id) {
+        if (auto iface = static_cast<AccessiblePieItem*>(QAccessible::accessibleInterface(id)))
+            iface->m_nameValid = false;
+    };
+
+    // Look up each child in the range, or go through the items instead if
+    // there are fewer of them, e.g. after selecting everything.
+    const int firstChild = firstRow * COLS;
+    const int endChild = (lastRow + 1) * COLS;
+    if (endChild - firstChild < m_items.size()) {
+        for (int child = firstChild; child < endChild; ++child) {
+            if (QAccessible::Id id = m_items.value(child))
+                invalidate(id);
+        }
+    } else {
+        for (auto it = m_items.cbegin(); it != m_items.cend(); ++it) {
+            if (firstChild <= it.key() && it.key() < endChild)
+                invalidate(it.value());
+        }
+    }
+}
+
+void AccessiblePieView::invalidateNames(const QItemSelection &selection) const
+{
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.parent().isValid())
+            invalidateNames(range.top(), range.bottom());
+    }
+}
+
+void AccessiblePieView::disconnectModel() const
+{
+    for (const QMetaObject::Connection &connection : qAsConst(m_connections))
+        QObject::disconnect(connection);
+    m_connections.clear();
+}
+
 // QAccessibleWidget::child(int) only deals with widget children, so we must
 // override it to return items in the view instead (items are not widgets).
 // Same for other child-based functions like childAt(), focusChild(), etc.
 QAccessibleInterface* AccessiblePieView::child(int index) const
 {
     Q_ASSERT(0 <= index && index < childCount());
+    if (isGrouped())
+        return group(index);
     return child(m_pieview->model()->index(index / COLS, index % COLS));
 }
 
@@ -315,12 +736,15 @@ QAccessibleInterface* AccessiblePieView::childAt(int x, int y) const
 {
     QModelIndex index = m_pieview->indexAt(m_pieview->mapFromGlobal(QPoint(x, y)));
     if (index.isValid())
-        return child(index);
+        return isGrouped() ? group(index.row() / m_pieview->accessibleGroupSize())
+                           : child(index);
     return nullptr; // no child at (x,y)
 }
 
 int AccessiblePieView::childCount() const
 {
+    if (isGrouped())
+        return groupCount();
     return ROWS * COLS;
 }
 
@@ -328,17 +752,45 @@ QAccessibleInterface* AccessiblePieView::focusChild() const
 {
     QModelIndex current = m_pieview->currentIndex();
     if (current.isValid())
-        return child(current);
+        return isGrouped() ? group(current.row() / m_pieview->accessibleGroupSize())
+                           : child(current);
     return nullptr;
 }
 
 int AccessiblePieView::indexOfChild(const QAccessibleInterface* iface) const
 {
     Q_ASSERT(iface && iface->isValid() && iface->parent() == this);
+    if (auto groupIface = dynamic_cast<const AccessiblePieGroup*>(iface))
+        return groupIface->m_group;
     Q_ASSERT(dynamic_cast<const AccessiblePieItem*>(iface) != nullptr);
     return static_cast<const AccessiblePieItem*>(iface)->index();
 }
 
+bool AccessiblePieView::isGrouped() const
+{
+    return m_pieview->accessibleGroupSize() > 0;
+}
+
+int AccessiblePieView::groupCount() const
+{
+    const int groupSize = m_pieview->accessibleGroupSize();
+    return groupSize > 0 ? (ROWS + groupSize - 1) / groupSize : 0;
+}
+
+// Like items, groups are only created when a screen reader asks for them.
+QAccessibleInterface* AccessiblePieView::group(int index) const
+{
+    Q_ASSERT(0 <= index && index < groupCount());
+    bindModel();
+    if (QAccessible::Id id = m_groups.value(index)) {
+        if (QAccessibleInterface* iface = QAccessible::accessibleInterface(id))
+            return iface;
+    }
+    auto iface = new AccessiblePieGroup(m_pieview, index);
+    m_groups.insert(index, QAccessible::registerAccessibleInterface(iface));
+    return iface;
+}
+
 bool AccessiblePieView::isValid() const
 {
     if (!m_pieview)
@@ -33,7 +33,11 @@
 #define ACCESSIBLEPIEVIEW_H
 
 #include <QAccessibleWidget>
+#include <QHash>
+#include <QItemSelectionModel>
+#include <QMap>
 #include <QPersistentModelIndex>
+#include <QPointer>
 
 class PieView;
 
@@ -42,6 +46,7 @@ QAccessibleInterface* accessiblePieViewFactory(const QString &classname, QObject
 class AccessiblePieItem : public QAccessibleInterface
 {
     friend class AccessiblePieView; // allow access to index()
+    friend class AccessiblePieGroup;
 
 public:
     AccessiblePieItem(PieView* pv, QModelIndex index);
@@ -61,19 +66,72 @@ public:
     QString text(QAccessible::Text t) const override;
     void setText(QAccessible::Text t, const QString &text) override;
 
+    // Items are allocated from a pool that recycles the slots of deleted
+    // items, since screen readers create and discard them by the thousand.
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
+    struct PoolStats {
+        int live = 0;           // items currently allocated
+        int capacity = 0;       // slots in the pool, live or free
+        qint64 allocations = 0; // items allocated so far
+        qint64 recycled = 0;    // allocations that reused a freed slot
+    };
+    static PoolStats poolStats();
+    static void trimPool();
+
 private:
     int index() const;
     QString name() const;
 
     QPersistentModelIndex m_index;
     PieView* m_pieview;
+
+    // Cached by name() until the row's data or selection state changes, or
+    // until the total differs from the one the percentage was based on.
+    mutable QString m_name;
+    mutable double m_nameTotal = 0.0;
+    mutable bool m_nameValid = false;
+};
+
+// In grouped mode (see PieView::setAccessibleGroupSize()) the view's children
+// are groups of consecutive rows, and the items are children of the groups.
+// A group is just a range of rows, so it creates its items on demand.
+class AccessiblePieGroup : public QAccessibleInterface
+{
+    friend class AccessiblePieView; // allow access to m_group
+
+public:
+    AccessiblePieGroup(PieView* pv, int group);
+    QAccessibleInterface* child(int index) const override;
+    QAccessibleInterface* childAt(int x, int y) const override;
+    int childCount() const override;
+    QAccessibleInterface* focusChild() const override;
+    int indexOfChild(const QAccessibleInterface* iface) const override;
+    bool isValid() const override;
+    QObject* object() const override;
+    QAccessibleInterface* parent() const override;
+    QRect rect() const override;
+    QAccessible::Role role() const override;
+    QAccessible::State state() const override;
+    QString text(QAccessible::Text t) const override;
+    void setText(QAccessible::Text t, const QString &text) override;
+
+private:
+    int firstRow() const;
+    int lastRow() const;
+
+    PieView* m_pieview;
+    int m_group;
 };
-Q_DECLARE_METATYPE(AccessiblePieItem*); // enable storing in QVariant
 
 class AccessiblePieView : public QAccessibleWidget
 {
+    friend class AccessiblePieItem; // allow access to group()
+
 public:
     AccessiblePieView(PieView* pv);
+    ~AccessiblePieView() override;
     QAccessibleInterface* child(int index) const override;
     QAccessibleInterface* childAt(int x, int y) const override;
     int childCount() const override;
@@ -85,9 +143,31 @@ public:
     QString text(QAccessible::Text t) const override;
     void setText(QAccessible::Text t, const QString &text) override;
 
-private:
+    // The interface of the item at index, wherever it is in the tree.
     QAccessibleInterface* child(QModelIndex index) const;
+    bool isGrouped() const;
+
+private:
+    int groupCount() const;
+    QAccessibleInterface* group(int index) const;
+    void bindModel() const;
+    void removeItems(int firstRow, int lastRow) const;
+    void reindexItems(int firstRow) const;
+    void clearItems() const;
+    void invalidateNames(int firstRow, int lastRow) const;
+    void invalidateNames(const QItemSelection &selection) const;
+    void disconnectModel() const;
+
     PieView* m_pieview;
+
+    // Interfaces created so far, items by their child index in the flat tree
+    // and groups by number. They are kept here rather than in the model so
+    // that creating one doesn't emit dataChanged.
+    mutable QMap<int, QAccessible::Id> m_items;
+    mutable QHash<int, QAccessible::Id> m_groups;
+    mutable QPointer<QAbstractItemModel> m_model;
+    mutable QPointer<QItemSelectionModel> m_selectionModel;
+    mutable QVector<QMetaObject::Connection> m_connections;
 };
 
 #endif // ACCESSIBLEPIEVIEW_H
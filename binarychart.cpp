@@ -0,0 +1,168 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#include "binarychart.h"
+
+#include <QSaveFile>
+
+#include <climits>
+#include <cstring>
+
+static const char magic[4] = { 'C', 'H', 'B', '\n' };
+
+static_assert(sizeof(BinaryChartFile::Header) == 48, "the header must not have padding");
+
+static quint64 align8(quint64 offset)
+{
+    return (offset + 7) & ~quint64(7);
+}
+
+bool BinaryChartFile::open(const QString &fileName)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(fileName);
+    return false;   // the arrays are little-endian, so they can't be used in place
+#else
+    file.setFileName(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    const quint64 size = quint64(file.size());
+    const uchar *base = size >= sizeof(Header) ? file.map(0, qint64(size)) : nullptr;
+    if (!base) {
+        file.close();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, base, sizeof header);
+    const quint64 count = header.rowCount;
+
+    // Each array must be aligned and lie inside the file.
+    auto fits = [size, count](quint64 offset, quint64 elementSize) {
+        return offset % elementSize == 0 && offset <= size
+                && count <= (size - offset) / elementSize;
+    };
+
+    if (std::memcmp(header.magic, magic, sizeof magic) != 0
+            || header.version != Version || count > INT_MAX
+            || !fits(header.valuesOffset, sizeof(double))
+            || !fits(header.colorsOffset, sizeof(QRgb))
+            || !fits(header.labelEndsOffset, sizeof(quint64))
+            || header.labelsOffset > header.labelEndsOffset) {
+        file.close();
+        return false;
+    }
+
+    rows = int(count);
+    values = reinterpret_cast<const double*>(base + header.valuesOffset);
+    colors = reinterpret_cast<const QRgb*>(base + header.colorsOffset);
+    labels = reinterpret_cast<const char*>(base + header.labelsOffset);
+    labelsSize = header.labelEndsOffset - header.labelsOffset;
+    labelEnds = reinterpret_cast<const quint64*>(base + header.labelEndsOffset);
+    return true;
+#endif
+}
+
+QString BinaryChartFile::label(int row) const
+{
+    const quint64 begin = row > 0 ? labelEnds[row - 1] : 0;
+    const quint64 end = labelEnds[row];
+    if (begin > end || end > labelsSize || end - begin > INT_MAX)
+        return QString();   // the file is corrupt
+
+    return QString::fromUtf8(labels + begin, int(end - begin));
+}
+
+ChartData BinaryChartFile::chartData() const
+{
+    ChartData data;
+    data.reserve(rows);
+    for (int row = 0; row < rows; ++row)
+        data.append(label(row), values[row], colors[row]);
+    return data;
+}
+
+/*
+    Writes \a data to \a fileName in the binary format. The file is only
+    replaced once it has been written completely.
+*/
+
+bool BinaryChartFile::write(const QString &fileName, const ChartData &data)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(fileName);
+    Q_UNUSED(data);
+    return false;
+#else
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    const quint64 count = quint64(data.size());
+
+    Header header;
+    std::memcpy(header.magic, magic, sizeof magic);
+    header.version = Version;
+    header.rowCount = count;
+    header.valuesOffset = sizeof(Header);
+    header.colorsOffset = header.valuesOffset + count * sizeof(double);
+    header.labelsOffset = header.colorsOffset + count * sizeof(QRgb);
+    header.labelEndsOffset = 0; // not known until the labels are written
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof header);
+    file.write(reinterpret_cast<const char*>(data.values.constData()),
+               qint64(count * sizeof(double)));
+    file.write(reinterpret_cast<const char*>(data.colors.constData()),
+               qint64(count * sizeof(QRgb)));
+
+    QVector<quint64> labelEnds;
+    labelEnds.reserve(data.size());
+    quint64 labelsSize = 0;
+    for (const QString &label : data.labels) {
+        const QByteArray utf8 = label.toUtf8();
+        file.write(utf8);
+        labelsSize += quint64(utf8.size());
+        labelEnds.append(labelsSize);
+    }
+
+    header.labelEndsOffset = align8(header.labelsOffset + labelsSize);
+    const int padding = int(header.labelEndsOffset - header.labelsOffset - labelsSize);
+    file.write(QByteArray(padding, '\0'));
+    file.write(reinterpret_cast<const char*>(labelEnds.constData()),
+               qint64(count * sizeof(quint64)));
+
+    file.seek(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof header);
+
+    return file.commit();   // fails if any of the writes did
+#endif
+}
@@ -0,0 +1,90 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#ifndef BINARYCHART_H
+#define BINARYCHART_H
+
+#include "chartdata.h"
+
+#include <QFile>
+
+// A chart in the binary .chb format, read in place from a memory-mapped file.
+//
+// The file starts with a BinaryChartHeader, followed by the values of all
+// rows as doubles, their colors as QRgb, their labels as UTF-8 (one after
+// the other) and finally the end of each label as an offset from the start
+// of the first label. Everything is little-endian and each array is aligned
+// to its element size, so the arrays can be used without being parsed.
+class BinaryChartFile
+{
+public:
+    enum { Version = 1 };
+
+    struct Header
+    {
+        char magic[4];          // "CHB\n"
+        quint32 version;
+        quint64 rowCount;
+        quint64 valuesOffset;
+        quint64 colorsOffset;
+        quint64 labelsOffset;
+        quint64 labelEndsOffset;
+    };
+
+    // Maps the file. Returns false if it can't be mapped or isn't a valid
+    // chart in a version we understand.
+    bool open(const QString &fileName);
+
+    int rowCount() const { return rows; }
+    double value(int row) const { return values[row]; }
+    QRgb color(int row) const { return colors[row]; }
+    QString label(int row) const;
+
+    ChartData chartData() const;
+    QString fileName() const { return file.fileName(); }
+
+    static bool write(const QString &fileName, const ChartData &data);
+    static bool isBinaryFileName(const QString &fileName)
+    {
+        return fileName.endsWith(QLatin1String(".chb"), Qt::CaseInsensitive);
+    }
+
+private:
+    QFile file;
+    int rows = 0;
+    const double *values = nullptr;
+    const QRgb *colors = nullptr;
+    const char *labels = nullptr;
+    quint64 labelsSize = 0;
+    const quint64 *labelEnds = nullptr;
+};
+
+#endif // BINARYCHART_H
@@ -1,13 +1,31 @@
-QT += widgets
+QT += widgets concurrent
+CONFIG += c++17
 requires(qtConfig(filedialog))
 
 HEADERS     = mainwindow.h \
+              accessibleeventqueue.h \
               accessiblepieview.h \
+              binarychart.h \
+              chartdata.h \
+              chartdiff.h \
+              chartfollower.h \
+              chartjournal.h \
+              chartloader.h \
+              chartparser.h \
+              columnarpiemodel.h \
               piemodel.h \
               pieview.h
 RESOURCES   = chart.qrc
 SOURCES     = main.cpp \
+              accessibleeventqueue.cpp \
               accessiblepieview.cpp \
+              binarychart.cpp \
+              chartdiff.cpp \
+              chartfollower.cpp \
+              chartjournal.cpp \
+              chartloader.cpp \
+              chartparser.cpp \
+              columnarpiemodel.cpp \
               mainwindow.cpp \
               piemodel.cpp \
               pieview.cpp
@@ -0,0 +1,107 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#ifndef CHARTDATA_H
+#define CHARTDATA_H
+
+#include <QColor>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+// The contents of a chart, with one entry per row in each array. Used to
+// move whole charts in and out of the models in one go.
+struct ChartData
+{
+    QVector<QString> labels;
+    QVector<double> values;
+    QVector<QRgb> colors;   // 0 (fully transparent) means no color
+
+    int size() const { return labels.size(); }
+
+    void append(const QString &label, double value, QRgb color)
+    {
+        labels.append(label);
+        values.append(value);
+        colors.append(color);
+    }
+
+    void append(const ChartData &other)
+    {
+        labels += other.labels;
+        values += other.values;
+        colors += other.colors;
+    }
+
+    ChartData mid(int position, int length) const
+    {
+        return { labels.mid(position, length), values.mid(position, length),
+                 colors.mid(position, length) };
+    }
+
+    void reserve(int rows)
+    {
+        labels.reserve(rows);
+        values.reserve(rows);
+        colors.reserve(rows);
+    }
+};
+
+Q_DECLARE_METATYPE(ChartData)
+
+// Implemented by the chart models so that a whole chart can be published at
+// once. Otherwise every row costs an insertRows() and several setData()
+// calls, each of which notifies every attached view.
+class ChartStorage
+{
+public:
+    virtual ~ChartStorage() = default;
+
+    // Replaces the chart with a single model reset.
+    virtual void setChartData(const ChartData &data) = 0;
+
+    // Inserts rows before row with a single row insertion, which may be
+    // followed by a single dataChanged() for the new rows.
+    virtual void insertChartData(int row, const ChartData &data) = 0;
+
+    // Adds rows to the end of the chart, as insertChartData() does.
+    virtual void appendChartData(const ChartData &data) = 0;
+
+    // Returns a copy of the whole chart.
+    virtual ChartData chartData() const = 0;
+
+    // Called before fileName is replaced. A model that reads the chart in
+    // place from that file must stop doing so, since a mapped file can't be
+    // replaced on every platform.
+    virtual void releaseFile(const QString &fileName) { Q_UNUSED(fileName) }
+};
+
+#endif // CHARTDATA_H
@@ -0,0 +1,153 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#include "chartdiff.h"
+
+#include <QAbstractItemModel>
+#include <QHash>
+
+#include <algorithm>
+
+/*
+    Returns which of the old rows to keep: the longest run of matched rows,
+    not necessarily adjacent, whose new rows are in the same order. The other
+    old rows have to be removed, and their new rows inserted.
+*/
+
+static QVector<bool> rowsToKeep(const QVector<int> &newRows)
+{
+    // Patience sorting: tails[k] is the old row that ends the best run of
+    // length k + 1 found so far, and previous[] links each row to the one
+    // before it in its run.
+    QVector<int> tails;
+    QVector<int> previous(newRows.size(), -1);
+    for (int row = 0; row < newRows.size(); ++row) {
+        if (newRows.at(row) < 0)
+            continue;
+        auto pos = std::lower_bound(tails.begin(), tails.end(), newRows.at(row),
+                                    [&newRows](int tail, int newRow) {
+                                        return newRows.at(tail) < newRow;
+                                    });
+        if (pos != tails.begin())
+            previous[row] = *(pos - 1);
+        if (pos == tails.end())
+            tails.append(row);
+        else
+            *pos = row;
+    }
+
+    QVector<bool> keep(newRows.size(), false);
+    for (int row = tails.isEmpty() ? -1 : tails.last(); row >= 0; row = previous.at(row))
+        keep[row] = true;
+    return keep;
+}
+
+int updateChart(QAbstractItemModel *model, ChartStorage *storage,
+                const ChartData &oldData, const ChartData &newData)
+{
+    // Match the rows by label. For each label, nextNewRow chains the new rows
+    // with that label in order, starting from firstNewRow.
+    QHash<QString, int> firstNewRow;
+    QVector<int> nextNewRow(newData.size(), -1);
+    for (int row = newData.size() - 1; row >= 0; --row) {
+        auto it = firstNewRow.find(newData.labels.at(row));
+        if (it == firstNewRow.end()) {
+            firstNewRow.insert(newData.labels.at(row), row);
+        } else {
+            nextNewRow[row] = *it;
+            *it = row;
+        }
+    }
+
+    QVector<int> newRows(oldData.size(), -1);   // the match for each old row
+    for (int row = 0; row < oldData.size(); ++row) {
+        auto it = firstNewRow.find(oldData.labels.at(row));
+        if (it == firstNewRow.end() || *it < 0)
+            continue;
+        newRows[row] = *it;
+        *it = nextNewRow.at(*it);
+    }
+
+    const QVector<bool> keep = rowsToKeep(newRows);
+    int changes = 0;
+
+    // Remove the old rows that aren't kept, a run at a time from the bottom
+    // so that the rows above don't move.
+    for (int end = oldData.size() - 1; end >= 0; --end) {
+        if (keep.at(end))
+            continue;
+        int start = end;
+        while (start > 0 && !keep.at(start - 1))
+            --start;
+        model->removeRows(start, end - start + 1);
+        changes += end - start + 1;
+        end = start;
+    }
+
+    // The kept rows are now in the same order as in the new data, so each
+    // run of new rows that aren't kept can be inserted, already filled in, at
+    // its own position.
+    QVector<bool> kept(newData.size(), false);
+    for (int row = 0; row < oldData.size(); ++row) {
+        if (keep.at(row))
+            kept[newRows.at(row)] = true;
+    }
+
+    for (int start = 0; start < newData.size(); ++start) {
+        if (kept.at(start))
+            continue;
+        int end = start;
+        while (end + 1 < newData.size() && !kept.at(end + 1))
+            ++end;
+        storage->insertChartData(start, newData.mid(start, end - start + 1));
+        changes += end - start + 1;
+        start = end;
+    }
+
+    // Finally update the values and colors of the kept rows.
+    for (int row = 0; row < oldData.size(); ++row) {
+        if (!keep.at(row))
+            continue;
+        const int newRow = newRows.at(row);
+        const double value = newData.values.at(newRow);
+        const QRgb color = newData.colors.at(newRow);
+        if (oldData.values.at(row) != value)
+            model->setData(model->index(newRow, 1), value);
+        if (oldData.colors.at(row) != color)
+            model->setData(model->index(newRow, 0),
+                           color ? QVariant(QColor::fromRgba(color)) : QVariant(),
+                           Qt::DecorationRole);
+        if (oldData.values.at(row) != value || oldData.colors.at(row) != color)
+            ++changes;
+    }
+
+    return changes;
+}
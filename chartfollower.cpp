@@ -0,0 +1,128 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#include "chartfollower.h"
+
+#include "chartparser.h"
+
+#include <QAbstractItemModel>
+#include <QFile>
+
+ChartFollower::ChartFollower(QAbstractItemModel *model, ChartStorage *storage, QObject *parent)
+: QObject(parent)
+, model(model)
+, storage(storage)
+{
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &ChartFollower::readNewLines);
+}
+
+void ChartFollower::follow(const QString &fileName, qint64 offset)
+{
+    stop();
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly) || !watcher.addPath(fileName))
+        return;
+
+    // Find the start of the line that the loaded part of the file ends in.
+    qint64 lineStart = offset;
+    while (lineStart > 0) {
+        const qint64 blockStart = qMax<qint64>(0, lineStart - 4096);
+        file.seek(blockStart);
+        const int newline = file.read(lineStart - blockStart).lastIndexOf('\n');
+        if (newline >= 0) {
+            lineStart = blockStart + newline + 1;
+            break;
+        }
+        lineStart = blockStart;
+    }
+
+    // If the file ended part way through a line when it was loaded, that part
+    // became the last row. Remove it, and add the line when it is complete.
+    if (lineStart < offset) {
+        file.seek(lineStart);
+        const QByteArray partialLine = file.read(offset - lineStart);
+        ChartData partialRow;
+        parseChart(partialLine.constData(), partialLine.constData() + partialLine.size(),
+                   &partialRow);
+        const int lastRow = model->rowCount() - 1;
+        if (partialRow.size() == 1 && lastRow >= 0
+                && model->index(lastRow, 0).data().toString() == partialRow.labels.at(0))
+            model->removeRows(lastRow, 1);
+    }
+
+    this->fileName = fileName;
+    this->offset = lineStart;
+    readNewLines();     // in case the file grew after it was loaded
+}
+
+void ChartFollower::stop()
+{
+    if (!fileName.isEmpty())
+        watcher.removePath(fileName);
+    fileName.clear();
+    offset = 0;
+}
+
+void ChartFollower::readNewLines()
+{
+    if (fileName.isEmpty())
+        return;
+
+    // The watcher forgets files that are replaced rather than written to.
+    if (!watcher.files().contains(fileName))
+        watcher.addPath(fileName);
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return; // perhaps being replaced; try again on the next change
+
+    const qint64 size = file.size();
+    if (size < offset) {
+        const QString replacedFileName = fileName;
+        stop();
+        emit fileReplaced(replacedFileName);
+        return;
+    }
+
+    if (size == offset || !file.seek(offset))
+        return;
+
+    const QByteArray newBytes = file.read(size - offset);
+    const int end = newBytes.lastIndexOf('\n') + 1;
+    if (end == 0)
+        return; // no complete line yet
+
+    ChartData rows;
+    parseChart(newBytes.constData(), newBytes.constData() + end, &rows);
+    offset += end;
+    storage->appendChartData(rows);
+}
@@ -0,0 +1,75 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#ifndef CHARTFOLLOWER_H
+#define CHARTFOLLOWER_H
+
+#include <QFileSystemWatcher>
+#include <QObject>
+
+QT_BEGIN_NAMESPACE
+class QAbstractItemModel;
+QT_END_NAMESPACE
+
+class ChartStorage;
+
+// Follows a .cht file that another program is still writing. Whenever the
+// file changes, the lines added since the last read are parsed and appended
+// to the chart in a single insertion. A line is only read once it is
+// complete, that is once its newline has been written.
+class ChartFollower : public QObject
+{
+    Q_OBJECT
+
+public:
+    ChartFollower(QAbstractItemModel *model, ChartStorage *storage, QObject *parent = nullptr);
+
+    // Starts following the file, which has already been loaded up to offset.
+    void follow(const QString &fileName, qint64 offset);
+    void stop();
+    bool isFollowing() const { return !fileName.isEmpty(); }
+
+signals:
+    // The file shrank or was replaced, so it has to be loaded again.
+    void fileReplaced(const QString &fileName);
+
+private slots:
+    void readNewLines();
+
+private:
+    QAbstractItemModel *model;
+    ChartStorage *storage;
+    QFileSystemWatcher watcher;
+    QString fileName;
+    qint64 offset = 0;      // the end of the last complete line read
+};
+
+#endif // CHARTFOLLOWER_H
@@ -0,0 +1,364 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#include "chartjournal.h"
+
+#include "binarychart.h"
+#include "chartparser.h"
+
+#include <QAbstractItemModel>
+#include <QColor>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+static const quint32 journalMagic = 0x43484a31;   // "CHJ1"
+
+// Once the journal is this large, the chart is rewritten instead.
+static const qint64 compactThreshold = 4 * 1024 * 1024;
+
+static QString journalFileName(const QString &chartFileName)
+{
+    return chartFileName + QLatin1String(".journal");
+}
+
+static void chartStamp(const QString &fileName, qint64 *size, qint64 *modified)
+{
+    const QFileInfo info(fileName);
+    *size = info.size();
+    *modified = info.lastModified().toMSecsSinceEpoch();
+}
+
+ChartJournal::ChartJournal(QAbstractItemModel *model, ChartStorage *storage, QObject *parent)
+: QObject(parent)
+, model(model)
+, storage(storage)
+{
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(1000);
+
+    connect(model, &QAbstractItemModel::dataChanged, this, &ChartJournal::recordChanges);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &ChartJournal::recordInsert);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, &ChartJournal::recordRemove);
+    connect(model, &QAbstractItemModel::modelReset, this, [this] {
+        if (isRecording())
+            compact();  // a reset can't be journaled
+    });
+    connect(&flushTimer, &QTimer::timeout, this, &ChartJournal::flush);
+    connect(&compactWatcher, &QFutureWatcher<bool>::finished,
+            this, &ChartJournal::compactFinished);
+}
+
+ChartJournal::~ChartJournal()
+{
+    close();
+}
+
+int ChartJournal::open(const QString &fileName)
+{
+    close();
+
+    // Charts in resources are read-only, so there is nowhere to put a journal.
+    if (fileName.startsWith(QLatin1Char(':')))
+        return 0;
+
+    chartFileName = fileName;
+    return replay();
+}
+
+void ChartJournal::close()
+{
+    if (compacting) {
+        compactWatcher.waitForFinished();
+        compactFinished();
+    }
+
+    flush();
+    journal.close();
+    chartFileName.clear();
+    journalMatches = false;
+}
+
+bool ChartJournal::beginRebase()
+{
+    if (rebasing)
+        return false;
+
+    flush();
+    rebasing = true;
+    rebaseFileName = chartFileName;
+    sinceRebase.clear();
+    return true;
+}
+
+void ChartJournal::endRebase(bool saved, const QString &fileName)
+{
+    rebasing = false;
+
+    if (saved && !rebaseFileName.isEmpty()) {
+        // The old journal stays complete until the new one has been written.
+        flush();
+        const bool resume = chartFileName == rebaseFileName;
+        if (resume)
+            journal.close();
+        if (writeJournal(fileName, sinceRebase) && resume) {
+            chartFileName = fileName;
+            journalMatches = true;
+        }
+    }
+
+    rebaseFileName.clear();
+    sinceRebase.clear();
+}
+
+void ChartJournal::recordChanges(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                                 const QVector<int> &roles)
+{
+    if (!isRecording())
+        return;
+
+    // Ignore roles that aren't saved, such as Qt::AccessibleDescriptionRole.
+    if (!roles.isEmpty() && !roles.contains(Qt::DisplayRole)
+            && !roles.contains(Qt::EditRole) && !roles.contains(Qt::DecorationRole))
+        return;
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+        recordRow(row);
+}
+
+void ChartJournal::recordInsert(const QModelIndex &parent, int first, int last)
+{
+    if (!isRecording() || parent.isValid())
+        return;
+
+    // Rows can be inserted with their contents, as insertChartData() does.
+    recordRows(InsertRows, first, last - first + 1);
+    for (int row = first; row <= last; ++row)
+        recordRow(row);
+}
+
+void ChartJournal::recordRemove(const QModelIndex &parent, int first, int last)
+{
+    if (!isRecording() || parent.isValid())
+        return;
+
+    recordRows(RemoveRows, first, last - first + 1);
+}
+
+void ChartJournal::recordRow(int row)
+{
+    const QModelIndex labelIndex = model->index(row, 0);
+    const QColor color = qvariant_cast<QColor>(labelIndex.data(Qt::DecorationRole));
+
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << quint8(SetRow) << qint32(row)
+           << labelIndex.data(Qt::DisplayRole).toString()
+           << model->index(row, 1).data(Qt::DisplayRole).toDouble()
+           << quint32(color.isValid() ? color.rgba() : 0);
+    append(record);
+}
+
+void ChartJournal::recordRows(RecordType type, int first, int count)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << quint8(type) << qint32(first) << qint32(count);
+    append(record);
+}
+
+void ChartJournal::append(const QByteArray &record)
+{
+    pending += record;
+    if (rebasing)
+        sinceRebase += record;
+    if (!flushTimer.isActive())
+        flushTimer.start();
+}
+
+/*
+    Appends the outstanding changes to the journal, creating it if there is
+    no journal for this version of the chart yet.
+*/
+
+void ChartJournal::flush()
+{
+    flushTimer.stop();
+    if (pending.isEmpty() || chartFileName.isEmpty())
+        return;
+
+    if (!journal.isOpen()) {
+        if (!journalMatches)
+            journalMatches = writeJournal(chartFileName, QByteArray());
+        journal.setFileName(journalFileName(chartFileName));
+        if (!journalMatches || !journal.open(QFile::WriteOnly | QFile::Append)) {
+            qWarning("Cannot write journal for %s, autosave is off", qPrintable(chartFileName));
+            pending.clear();
+            chartFileName.clear();
+            return;
+        }
+    }
+
+    journal.write(pending);
+    journal.flush();
+    pending.clear();
+
+    if (journal.size() > compactThreshold)
+        compact();
+}
+
+/*
+    Rewrites the chart in the background. The journal is started again once
+    the chart has been written.
+*/
+
+void ChartJournal::compact()
+{
+    if (chartFileName.isEmpty() || !beginRebase())
+        return;
+
+    const ChartData data = storage->chartData();
+    const auto write = BinaryChartFile::isBinaryFileName(chartFileName)
+            ? &BinaryChartFile::write : &writeChartFile;
+    storage->releaseFile(chartFileName);
+    compacting = true;
+    compactWatcher.setFuture(QtConcurrent::run(write, chartFileName, data));
+}
+
+void ChartJournal::compactFinished()
+{
+    if (!compacting)
+        return; // already finished by close()
+
+    compacting = false;
+    endRebase(compactWatcher.result(), rebaseFileName);
+}
+
+/*
+    Applies the journal to the chart if it was written for the chart file as
+    it is now. Returns the number of changes applied.
+*/
+
+int ChartJournal::replay()
+{
+    QFile file(journalFileName(chartFileName));
+    if (!file.open(QFile::ReadOnly))
+        return 0;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0;
+    qint64 size = 0;
+    qint64 modified = 0;
+    stream >> magic >> size >> modified;
+
+    qint64 chartSize = 0;
+    qint64 chartModified = 0;
+    chartStamp(chartFileName, &chartSize, &chartModified);
+    if (stream.status() != QDataStream::Ok || magic != journalMagic
+            || size != chartSize || modified != chartModified)
+        return 0;   // the journal is for another version of the chart
+
+    journalMatches = true;
+    replaying = true;
+
+    int changes = 0;
+    bool damaged = false;
+    while (!stream.atEnd()) {
+        quint8 type = 0;
+        qint32 row = 0;
+        stream >> type >> row;
+
+        const int rows = model->rowCount();
+        bool applied = false;
+        if (type == SetRow) {
+            QString label;
+            double value = 0.0;
+            quint32 color = 0;
+            stream >> label >> value >> color;
+            if (stream.status() == QDataStream::Ok && 0 <= row && row < rows) {
+                const QModelIndex labelIndex = model->index(row, 0);
+                model->setData(labelIndex, label);
+                model->setData(model->index(row, 1), value);
+                model->setData(labelIndex, color ? QVariant(QColor::fromRgba(color)) : QVariant(),
+                               Qt::DecorationRole);
+                applied = true;
+            }
+        } else if (type == InsertRows || type == RemoveRows) {
+            qint32 count = 0;
+            stream >> count;
+            const int end = type == InsertRows ? rows : rows - count;
+            if (stream.status() == QDataStream::Ok && count > 0 && 0 <= row && row <= end)
+                applied = type == InsertRows ? model->insertRows(row, count)
+                                             : model->removeRows(row, count);
+        }
+
+        if (!applied) {
+            damaged = true;
+            break;
+        }
+        ++changes;
+    }
+
+    replaying = false;
+
+    // A journal that ends in a partial or invalid record, for example after
+    // a crash, can't be appended to. Start again from a rewrite.
+    if (damaged) {
+        qWarning("Journal for %s is damaged, ignoring the rest of it", qPrintable(chartFileName));
+        compact();
+    }
+
+    return changes;
+}
+
+bool ChartJournal::writeJournal(const QString &fileName, const QByteArray &records)
+{
+    QSaveFile file(journalFileName(fileName));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    qint64 size = 0;
+    qint64 modified = 0;
+    chartStamp(fileName, &size, &modified);
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << journalMagic << size << modified;
+    file.write(records);
+
+    return file.commit();
+}
@@ -0,0 +1,116 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#ifndef CHARTJOURNAL_H
+#define CHARTJOURNAL_H
+
+#include <QFile>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QTimer>
+
+QT_BEGIN_NAMESPACE
+class QAbstractItemModel;
+class QModelIndex;
+QT_END_NAMESPACE
+
+class ChartStorage;
+
+// Autosaves a chart by appending each change to a journal next to the chart
+// file, so the cost of saving depends on the size of the change rather than
+// the size of the chart. The journal is replayed when the chart is opened
+// again, and compacted into a rewrite of the chart once it grows too large.
+//
+// The journal is named after the chart with ".journal" added. It starts with
+// the size and modification time of the chart it applies to, so a journal
+// for an older version of the chart is ignored.
+class ChartJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    ChartJournal(QAbstractItemModel *model, ChartStorage *storage, QObject *parent = nullptr);
+    ~ChartJournal() override;
+
+    // Replays any journal for the chart just loaded from fileName and starts
+    // journaling changes to it. Returns the number of changes replayed.
+    int open(const QString &fileName);
+    // Writes any outstanding changes and stops journaling.
+    void close();
+
+    // Called before and after the whole chart is saved to fileName, so that
+    // the journal can start again from the saved file. Changes made while the
+    // file is written are kept for the new journal. beginRebase() returns
+    // false if a save is already running.
+    bool beginRebase();
+    void endRebase(bool saved, const QString &fileName);
+
+private slots:
+    void recordChanges(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                       const QVector<int> &roles);
+    void recordInsert(const QModelIndex &parent, int first, int last);
+    void recordRemove(const QModelIndex &parent, int first, int last);
+    void compact();
+    void compactFinished();
+    void flush();
+
+private:
+    enum RecordType : quint8 {
+        SetRow = 1,     // row, label, value, color
+        InsertRows,     // first row, count
+        RemoveRows,     // first row, count
+    };
+
+    bool isRecording() const { return !chartFileName.isEmpty() && !replaying; }
+    void recordRow(int row);
+    void recordRows(RecordType type, int first, int count);
+    void append(const QByteArray &record);
+    int replay();
+    bool writeJournal(const QString &fileName, const QByteArray &records);
+
+    QAbstractItemModel *model;
+    ChartStorage *storage;
+
+    QString chartFileName;      // empty unless journaling
+    QFile journal;              // opened for appending when first needed
+    bool journalMatches = false;    // the journal on disk is for this chart
+    QByteArray pending;         // changes not yet written
+    QTimer flushTimer;
+    bool replaying = false;
+
+    bool rebasing = false;
+    bool compacting = false;
+    QString rebaseFileName;     // the chart being journaled when rebasing began
+    QByteArray sinceRebase;     // changes since beginRebase()
+    QFutureWatcher<bool> compactWatcher;
+};
+
+#endif // CHARTJOURNAL_H
@@ -0,0 +1,134 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#include "chartloader.h"
+
+#include "chartparser.h"
+
+#include <QFile>
+#include <QThread>
+#include <QtConcurrent>
+
+ChartLoader::ChartLoader(QObject *parent)
+: QObject(parent)
+{
+    qRegisterMetaType<ChartData>();
+}
+
+ChartLoader::~ChartLoader()
+{
+    // Workers use the loader until they notice that they were canceled, so
+    // this is the one place that has to wait for them.
+    cancel();
+    for (QThread *worker : findChildren<QThread*>(QString(), Qt::FindDirectChildrenOnly))
+        worker->wait();
+}
+
+void ChartLoader::load(const QString &fileName)
+{
+    cancel();
+
+    const int job = currentJob;
+    thread = QThread::create([this, fileName, job] { run(fileName, job); });
+    thread->setParent(this);
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+}
+
+/*
+    Returns straight away. The worker notices at the end of the chunk it is
+    parsing, and anything it posts before then is dropped. It deletes itself
+    once it has finished.
+*/
+
+void ChartLoader::cancel()
+{
+    if (!thread)
+        return;
+
+    ++currentJob;
+    thread = nullptr;
+}
+
+/*
+    Loads the file. Runs on the worker thread, so everything it reports goes
+    through post().
+*/
+
+void ChartLoader::run(const QString &fileName, int job)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        post(job, [this] {
+            thread = nullptr;
+            emit finished(false);
+        });
+        return;
+    }
+
+    QByteArray buffer;
+    const ChartText text = mapChartFile(&file, &buffer);
+    const qint64 bytesTotal = file.size();
+    post(job, [this, bytesTotal] { emit opened(bytesTotal); });
+
+    // The chunks are parsed in parallel, but handed over in order.
+    const QVector<ChartText> chunks = splitChart(text);
+    QFuture<ChartData> parts = QtConcurrent::mapped(chunks, parseChartText);
+
+    for (int i = 0; i < chunks.size(); ++i) {
+        if (currentJob != job) {
+            parts.cancel();
+            parts.waitForFinished();
+            return;
+        }
+        const ChartData rows = parts.resultAt(i);
+        const qint64 bytesLoaded = bytesTotal - (text.end - chunks.at(i).end);
+        post(job, [this, rows, bytesLoaded] { emit rowsLoaded(rows, bytesLoaded); });
+    }
+
+    post(job, [this] {
+        thread = nullptr;
+        emit finished(true);
+    });
+}
+
+/*
+    Calls \a function on the thread that the loader belongs to, unless \a job
+    has been canceled by then.
+*/
+
+void ChartLoader::post(int job, std::function<void ()> function)
+{
+    QMetaObject::invokeMethod(this, [this, job, function] {
+        if (currentJob == job)
+            function();
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,78 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#ifndef CHARTLOADER_H
+#define CHARTLOADER_H
+
+#include "chartdata.h"
+
+#include <QObject>
+
+#include <atomic>
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+// Loads a chart file on a worker thread. The rows are handed over in batches
+// as they are parsed, so the chart can be shown while the rest of the file is
+// still loading. Only one file is loaded at a time.
+class ChartLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    ChartLoader(QObject *parent = nullptr);
+    ~ChartLoader() override;
+
+    // Starts loading the file, canceling any earlier load.
+    void load(const QString &fileName);
+    void cancel();
+    bool isLoading() const { return thread != nullptr; }
+
+signals:
+    // The file was opened and has this many bytes.
+    void opened(qint64 bytesTotal);
+    // The next rows of the file, with the offset in the file that they end at.
+    void rowsLoaded(const ChartData &rows, qint64 bytesLoaded);
+    // The load ended. Not emitted for loads that are canceled.
+    void finished(bool ok);
+
+private:
+    void run(const QString &fileName, int job);
+    void post(int job, std::function<void ()> function);
+
+    QThread *thread = nullptr;
+    std::atomic<int> currentJob { 0 };   // earlier jobs have been canceled
+};
+
+#endif // CHARTLOADER_H
@@ -0,0 +1,302 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#include "chartparser.h"
+
+#include <QFile>
+#include <QLocale>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent>
+
+#include <cstring>
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Like QString::toDouble(), returns 0 unless the whole field (ignoring any
+// surrounding whitespace) is a number.
+static double parseValue(const char *begin, const char *end)
+{
+    while (begin != end && isSpace(*begin))
+        ++begin;
+    while (end != begin && isSpace(end[-1]))
+        --end;
+    if (end - begin > 1 && begin[0] == '+' && begin[1] != '-')
+        ++begin;    // an explicit plus sign, but not "+-"
+
+    // Numbers are ASCII, so widen them into a buffer on the stack rather than
+    // a QString. The C locale makes the decimal point '.' whatever the user's
+    // locale is, as in QString::toDouble().
+    QChar text[64];
+    const int length = int(end - begin);
+    if (length == 0 || length > int(sizeof text / sizeof *text))
+        return 0.0;
+    for (int i = 0; i < length; ++i)
+        text[i] = QLatin1Char(begin[i]);
+
+    bool ok = false;
+    const double value = QLocale::c().toDouble(QStringView(text, length), &ok);
+    return ok ? value : 0.0;
+}
+
+// Returns 0 if the field isn't a valid color.
+static QRgb parseColor(const char *begin, const char *end)
+{
+    if (end - begin == 7 && *begin == '#') {
+        QRgb rgb = 0;
+        const char *pos = begin + 1;
+        for (; pos != end; ++pos) {
+            const int digit = hexDigit(*pos);
+            if (digit < 0)
+                break;
+            rgb = (rgb << 4) | QRgb(digit);
+        }
+        if (pos == end)
+            return qRgb(qRed(rgb), qGreen(rgb), qBlue(rgb));
+    }
+
+    // Color names and the less common # formats are rare enough to leave to
+    // QColor.
+    const QColor color(QString::fromLatin1(begin, int(end - begin)));
+    return color.isValid() ? color.rgba() : 0;
+}
+
+// Files are only split into chunks of at least this many bytes, because
+// below that the cost of scheduling the chunks exceeds the time saved.
+static const qint64 minimumChunkSize = 1024 * 1024;
+
+ChartText mapChartFile(QFile *file, QByteArray *buffer)
+{
+    const qint64 size = file->size();
+    ChartText text = { nullptr, nullptr };
+    if (size > 0)
+        text.begin = reinterpret_cast<const char*>(file->map(0, size));
+
+    if (text.begin) {
+        text.end = text.begin + size;
+    } else {
+        // Files that can't be mapped, such as compressed resources, are read
+        // into memory instead.
+        *buffer = file->readAll();
+        text.begin = buffer->constData();
+        text.end = text.begin + buffer->size();
+    }
+
+    if (text.end - text.begin >= 3 && std::memcmp(text.begin, "\xEF\xBB\xBF", 3) == 0)
+        text.begin += 3;    // skip the byte order mark
+
+    return text;
+}
+
+QVector<ChartText> splitChart(const ChartText &text)
+{
+    const qint64 size = text.end - text.begin;
+    const qint64 maximumChunks = qMax(1, QThread::idealThreadCount()) * 4;
+    const qint64 chunkSize = qMax(minimumChunkSize, (size + maximumChunks - 1) / maximumChunks);
+
+    QVector<ChartText> chunks;
+    const char *chunkBegin = text.begin;
+    while (text.end - chunkBegin > chunkSize) {
+        const char *split = chunkBegin + chunkSize;
+        auto newline = static_cast<const char*>(std::memchr(split, '\n', size_t(text.end - split)));
+        if (!newline)
+            break;
+        chunks.append({ chunkBegin, newline + 1 });
+        chunkBegin = newline + 1;
+    }
+    if (chunkBegin != text.end)
+        chunks.append({ chunkBegin, text.end });
+
+    return chunks;
+}
+
+ChartData parseChartText(const ChartText &text)
+{
+    ChartData data;
+    parseChart(text.begin, text.end, &data);
+    return data;
+}
+
+bool readChartFile(const QString &fileName, ChartData *data)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    QByteArray buffer;
+    const ChartText text = mapChartFile(&file, &buffer);
+    const QVector<ChartText> chunks = splitChart(text);
+    if (chunks.size() <= 1) {
+        parseChart(text.begin, text.end, data);
+        return true;
+    }
+
+    // Every chunk starts at the beginning of a line, so parsing the chunks
+    // separately and joining them in order gives the same rows as parsing
+    // the whole file at once.
+    const QVector<ChartData> parts =
+        QtConcurrent::blockingMapped<QVector<ChartData>>(chunks, parseChartText);
+
+    int rows = data->size();
+    for (const ChartData &part : parts)
+        rows += part.size();
+    data->reserve(rows);
+    for (const ChartData &part : parts)
+        data->append(part);
+
+    return true;    // the file is unmapped when it is closed
+}
+
+// Rows are formatted into a buffer that is written out whenever it holds at
+// least this many bytes.
+static const int writeBufferSize = 64 * 1024;
+
+// Appends the text as UTF-8, without the temporary QByteArray that
+// QString::toUtf8() would allocate.
+static void appendUtf8(QByteArray *buffer, const QString &text)
+{
+    const QChar *chars = text.constData();
+    const int length = text.size();
+    for (int i = 0; i < length; ++i) {
+        uint code = chars[i].unicode();
+        if (code < 0x80) {
+            buffer->append(char(code));
+            continue;
+        }
+
+        if (QChar::isHighSurrogate(code) && i + 1 < length && chars[i + 1].isLowSurrogate())
+            code = QChar::surrogateToUcs4(ushort(code), chars[++i].unicode());
+        else if (QChar::isSurrogate(code))
+            code = QChar::ReplacementCharacter;
+
+        if (code < 0x800) {
+            buffer->append(char(0xc0 | (code >> 6)));
+        } else if (code < 0x10000) {
+            buffer->append(char(0xe0 | (code >> 12)));
+            buffer->append(char(0x80 | ((code >> 6) & 0x3f)));
+        } else {
+            buffer->append(char(0xf0 | (code >> 18)));
+            buffer->append(char(0x80 | ((code >> 12) & 0x3f)));
+            buffer->append(char(0x80 | ((code >> 6) & 0x3f)));
+        }
+        buffer->append(char(0x80 | (code & 0x3f)));
+    }
+}
+
+// Appends the shortest text that parses back to the same value.
+static void appendValue(QByteArray *buffer, double value)
+{
+    buffer->append(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+}
+
+// Appends the color as #rrggbb, or as #aarrggbb if it isn't opaque.
+static void appendColor(QByteArray *buffer, QRgb rgba)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    if (rgba == 0)
+        return; // no color
+
+    char text[9] = { '#' };
+    const int digits = qAlpha(rgba) == 255 ? 6 : 8;
+    for (int i = 0; i < digits; ++i)
+        text[digits - i] = hexDigits[(rgba >> (4 * i)) & 0xf];
+    buffer->append(text, digits + 1);
+}
+
+bool writeChartFile(const QString &fileName, const ChartData &data)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        return false;
+
+    QByteArray buffer;
+    buffer.reserve(writeBufferSize + 1024);
+    for (int row = 0; row < data.size(); ++row) {
+        appendUtf8(&buffer, data.labels.at(row));
+        buffer.append(',');
+        appendValue(&buffer, data.values.at(row));
+        buffer.append(',');
+        appendColor(&buffer, data.colors.at(row));
+        buffer.append('\n');
+
+        if (buffer.size() >= writeBufferSize) {
+            file.write(buffer);
+            buffer.resize(0);   // keeps the reserved capacity
+        }
+    }
+    file.write(buffer);
+
+    return file.commit();   // fails if any of the writes did
+}
+
+void parseChart(const char *begin, const char *end, ChartData *data)
+{
+    const char *line = begin;
+    while (line < end) {
+        auto newline = static_cast<const char*>(std::memchr(line, '\n', size_t(end - line)));
+        const char *lineEnd = newline ? newline : end;
+        const char *next = newline ? newline + 1 : end;
+        if (lineEnd != line && lineEnd[-1] == '\r')
+            --lineEnd;
+
+        const char *fields[4] = { line };
+        int fieldCount = 1;
+        for (const char *pos = line; fieldCount < 4; ++fieldCount) {
+            pos = static_cast<const char*>(std::memchr(pos, ',', size_t(lineEnd - pos)));
+            if (!pos)
+                break;
+            fields[fieldCount] = ++pos;
+        }
+
+        if (fieldCount >= 3) {
+            const char *colorEnd = fieldCount == 4 ? fields[3] - 1 : lineEnd;
+            data->append(QString::fromUtf8(fields[0], int(fields[1] - 1 - fields[0])),
+                         parseValue(fields[1], fields[2] - 1),
+                         parseColor(fields[2], colorEnd));
+        }
+
+        line = next;
+    }
+}
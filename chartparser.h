@@ -0,0 +1,81 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#ifndef CHARTPARSER_H
+#define CHARTPARSER_H
+
+#include "chartdata.h"
+
+QT_BEGIN_NAMESPACE
+class QFile;
+QT_END_NAMESPACE
+
+// Readers and a writer for the .cht format, which has one slice per line:
+//
+//     label,value,color
+//
+// The label is UTF-8, the value is a number and the color is anything that
+// QColor understands, usually #rrggbb. Empty lines and lines with fewer than
+// three fields are skipped, as are any fields after the third.
+
+// Appends the slices in the file to data. Returns false if the file could not
+// be opened. Large files are split into chunks that are parsed in parallel.
+bool readChartFile(const QString &fileName, ChartData *data);
+
+// Writes data to the file, replacing it only once it has been written
+// completely. Returns false if the file could not be written.
+bool writeChartFile(const QString &fileName, const ChartData &data);
+
+// A range of chart text, from begin up to but not including end.
+struct ChartText
+{
+    const char *begin;
+    const char *end;
+};
+
+// Returns the text of a file that is open for reading, without any byte order
+// mark. The file is mapped into memory if possible, otherwise it is read into
+// buffer. The text is valid for as long as the file is open and the buffer
+// exists.
+ChartText mapChartFile(QFile *file, QByteArray *buffer);
+
+// Splits the text into chunks of whole lines, to be parsed in parallel.
+// Small texts are returned as a single chunk.
+QVector<ChartText> splitChart(const ChartText &text);
+
+// Parses the text into a new ChartData.
+ChartData parseChartText(const ChartText &text);
+
+// Appends the slices in the text from begin to end to data. The text is
+// parsed in place; only the labels are copied.
+void parseChart(const char *begin, const char *end, ChartData *data);
+
+#endif // CHARTPARSER_H
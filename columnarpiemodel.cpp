@@ -0,0 +1,329 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#include "columnarpiemodel.h"
+
+#include "binarychart.h"
+
+#include <QFileInfo>
+
+#include <algorithm>
+
+ColumnarPieModel::ColumnarPieModel(int rows, QObject *parent)
+: QAbstractTableModel(parent)
+, labels(rows)
+, values(rows, 0.0)
+, colors(rows, 0)
+{
+}
+
+ColumnarPieModel::~ColumnarPieModel()
+{
+}
+
+int ColumnarPieModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return mappedFile ? mappedFile->rowCount() : labels.size();
+}
+
+int ColumnarPieModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant ColumnarPieModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    int row = index.row();
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        if (index.column() == 0)
+            return label(row);
+        if (index.column() == 1)
+            return value(row);
+        break;
+    case Qt::DecorationRole:
+        if (index.column() == 0 && color(row) != 0)
+            return QColor::fromRgba(color(row));
+        break;
+    default:
+        break;
+    }
+
+    auto it = otherRoles.constFind(cell(row, index.column()));
+    if (it != otherRoles.constEnd())
+        return it->value(role);
+
+    return QVariant();
+}
+
+bool ColumnarPieModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid())
+        return false;
+
+    int row = index.row();
+    QVector<int> roles = { role };
+
+    if (role == Qt::DisplayRole || role == Qt::EditRole || role == Qt::DecorationRole)
+        detach();
+
+    if ((role == Qt::DisplayRole || role == Qt::EditRole) && index.column() == 0) {
+        labels[row] = value.toString();
+        roles = { Qt::DisplayRole, Qt::EditRole };
+    } else if ((role == Qt::DisplayRole || role == Qt::EditRole) && index.column() == 1) {
+        values[row] = value.toDouble();
+        roles = { Qt::DisplayRole, Qt::EditRole };
+    } else if (role == Qt::DecorationRole && index.column() == 0) {
+        QColor color = qvariant_cast<QColor>(value);
+        colors[row] = color.isValid() ? color.rgba() : 0;
+    } else if (value.isValid()) {
+        otherRoles[cell(row, index.column())].insert(role, value);
+    } else {
+        auto it = otherRoles.find(cell(row, index.column()));
+        if (it != otherRoles.end()) {
+            it->remove(role);
+            if (it->isEmpty())
+                otherRoles.erase(it);
+        }
+    }
+
+    emit dataChanged(index, index, roles);
+    return true;
+}
+
+QVariant ColumnarPieModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && 0 <= section && section < columnCount()
+            && (role == Qt::DisplayRole || role == Qt::EditRole))
+        return headers[section];
+
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+bool ColumnarPieModel::setHeaderData(int section, Qt::Orientation orientation,
+                                     const QVariant &value, int role)
+{
+    if (orientation != Qt::Horizontal || section < 0 || section >= columnCount()
+            || (role != Qt::DisplayRole && role != Qt::EditRole))
+        return false;
+
+    headers[section] = value.toString();
+    emit headerDataChanged(orientation, section, section);
+    return true;
+}
+
+Qt::ItemFlags ColumnarPieModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+
+    return Qt::ItemIsSelectable | Qt::ItemIsEditable | Qt::ItemIsEnabled;
+}
+
+bool ColumnarPieModel::insertRows(int row, int count, const QModelIndex &parent)
+{
+    if (parent.isValid() || row < 0 || row > rowCount() || count < 1)
+        return false;
+
+    detach();
+    beginInsertRows(QModelIndex(), row, row + count - 1);
+    labels.insert(row, count, QString());
+    values.insert(row, count, 0.0);
+    colors.insert(row, count, 0);
+    moveOtherRoles(row, count);
+    endInsertRows();
+
+    return true;
+}
+
+bool ColumnarPieModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+    if (parent.isValid() || row < 0 || count < 1 || row + count > rowCount())
+        return false;
+
+    const int endRow = row + count - 1;
+    clearOtherRoles(row, endRow);
+    detach();
+
+    beginRemoveRows(QModelIndex(), row, endRow);
+    labels.remove(row, count);
+    values.remove(row, count);
+    colors.remove(row, count);
+    moveOtherRoles(endRow + 1, -count);
+    endRemoveRows();
+
+    return true;
+}
+
+void ColumnarPieModel::setChartData(const ChartData &data)
+{
+    beginResetModel();
+    clearOtherRoles(0, rowCount() - 1);
+    mappedFile.reset();
+    labels = data.labels;
+    values = data.values;
+    colors = data.colors;
+    endResetModel();
+}
+
+void ColumnarPieModel::insertChartData(int row, const ChartData &data)
+{
+    if (data.size() == 0)
+        return;
+
+    detach();
+    const int count = data.size();
+    beginInsertRows(QModelIndex(), row, row + count - 1);
+    if (row == labels.size()) {
+        labels += data.labels;
+        values += data.values;
+        colors += data.colors;
+    } else {
+        labels.insert(row, count, QString());
+        values.insert(row, count, 0.0);
+        colors.insert(row, count, 0);
+        std::copy(data.labels.cbegin(), data.labels.cend(), labels.begin() + row);
+        std::copy(data.values.cbegin(), data.values.cend(), values.begin() + row);
+        std::copy(data.colors.cbegin(), data.colors.cend(), colors.begin() + row);
+        moveOtherRoles(row, count);
+    }
+    endInsertRows();
+}
+
+void ColumnarPieModel::appendChartData(const ChartData &data)
+{
+    insertChartData(rowCount(), data);
+}
+
+ChartData ColumnarPieModel::chartData() const
+{
+    if (mappedFile)
+        return mappedFile->chartData();
+    return { labels, values, colors };
+}
+
+// The rows are copied into the arrays, as for the first change, so that the
+// file is no longer mapped.
+void ColumnarPieModel::releaseFile(const QString &fileName)
+{
+    if (mappedFile && QFileInfo(mappedFile->fileName()) == QFileInfo(fileName))
+        detach();
+}
+
+bool ColumnarPieModel::setChartFile(const QString &fileName)
+{
+    QScopedPointer<BinaryChartFile> file(new BinaryChartFile);
+    if (!file->open(fileName))
+        return false;
+
+    beginResetModel();
+    clearOtherRoles(0, rowCount() - 1);
+    labels.clear();
+    values.clear();
+    colors.clear();
+    mappedFile.swap(file);
+    endResetModel();
+
+    return true;
+}
+
+QString ColumnarPieModel::label(int row) const
+{
+    return mappedFile ? mappedFile->label(row) : labels.at(row);
+}
+
+double ColumnarPieModel::value(int row) const
+{
+    return mappedFile ? mappedFile->value(row) : values.at(row);
+}
+
+QRgb ColumnarPieModel::color(int row) const
+{
+    return mappedFile ? mappedFile->color(row) : colors.at(row);
+}
+
+/*
+    Copies the rows of a mapped file into the arrays, so that they can be
+    changed. This is only needed the first time the chart is changed after
+    the file was opened.
+*/
+
+void ColumnarPieModel::detach()
+{
+    if (!mappedFile)
+        return;
+
+    const ChartData data = mappedFile->chartData();
+    labels = data.labels;
+    values = data.values;
+    colors = data.colors;
+    mappedFile.reset();
+}
+
+/*
+    Forgets the other roles of the rows from \a startRow to \a endRow.
+*/
+
+void ColumnarPieModel::clearOtherRoles(int startRow, int endRow)
+{
+    auto it = otherRoles.lowerBound(cell(startRow, 0));
+    const int endCell = cell(endRow + 1, 0);
+
+    while (it != otherRoles.end() && it.key() < endCell)
+        it = otherRoles.erase(it);
+}
+
+/*
+    Moves the other roles of the rows from \a row onwards by \a count rows,
+    which is negative if rows were removed.
+*/
+
+void ColumnarPieModel::moveOtherRoles(int row, int count)
+{
+    QMap<int, QMap<int, QVariant>> moved;
+    const int offset = count * columnCount();
+
+    auto it = otherRoles.lowerBound(cell(row, 0));
+    while (it != otherRoles.end()) {
+        moved.insert(it.key() + offset, it.value());
+        it = otherRoles.erase(it);
+    }
+
+    for (auto movedIt = moved.cbegin(); movedIt != moved.cend(); ++movedIt)
+        otherRoles.insert(movedIt.key(), movedIt.value());
+}
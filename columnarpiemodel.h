@@ -0,0 +1,110 @@
+//============================================================================
+// Copyright (c) 2020, Peter Jonas
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//============================================================================
+
+#ifndef COLUMNARPIEMODEL_H
+#define COLUMNARPIEMODEL_H
+
+#include "chartdata.h"
+
+#include <QAbstractTableModel>
+#include <QColor>
+#include <QMap>
+#include <QScopedPointer>
+#include <QVector>
+
+class BinaryChartFile;
+
+// A model for very large charts. Instead of allocating a QStandardItem for
+// every cell, with each role stored in its own QVariant, it keeps the labels,
+// values and colors of all rows in three arrays. It provides the same roles
+// as PieModel, so PieView and AccessiblePieView work with either model.
+//
+// A row in PieModel costs two items, their private data, role vectors and
+// QVariant payloads, while here it costs 12 bytes plus its label. To compare
+// them, run "chart --measure-memory 1000000" with and without --columnar,
+// which reports the memory each model takes for a million rows.
+//
+// The model can also show a binary .chb file in place, reading the rows from
+// the mapped file as they are needed. They are copied into the arrays the
+// first time the chart is changed.
+class ColumnarPieModel : public QAbstractTableModel, public ChartStorage
+{
+    Q_OBJECT
+
+public:
+    ColumnarPieModel(int rows, QObject *parent = nullptr);
+    ~ColumnarPieModel() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+    bool setHeaderData(int section, Qt::Orientation orientation, const QVariant &value,
+                       int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool insertRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+    bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+
+    void setChartData(const ChartData &data) override;
+    void insertChartData(int row, const ChartData &data) override;
+    void appendChartData(const ChartData &data) override;
+    ChartData chartData() const override;
+    void releaseFile(const QString &fileName) override;
+
+    // Replaces the chart with the one in a .chb file, without reading it.
+    // Returns false if the file isn't a valid binary chart.
+    bool setChartFile(const QString &fileName);
+
+private:
+    int cell(int row, int column) const { return row * columnCount() + column; }
+    void clearOtherRoles(int startRow, int endRow);
+    void moveOtherRoles(int row, int count);
+    void detach();
+
+    QString label(int row) const;
+    double value(int row) const;
+    QRgb color(int row) const;
+
+    QScopedPointer<BinaryChartFile> mappedFile;   // if set, the arrays are empty
+    QVector<QString> labels;
+    QVector<double> values;
+    QVector<QRgb> colors;   // 0 (fully transparent) means no color was set
+
+    // Any other roles, such as Qt::AccessibleDescriptionRole, are rarely
+    // set, so they are kept in a map by cell number rather than in arrays.
+    QMap<int, QMap<int, QVariant>> otherRoles;
+
+    QString headers[2];
+};
+
+#endif // COLUMNARPIEMODEL_H
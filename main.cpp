@@ -50,10 +50,179 @@
 
 #include <QApplication>
 #include <QAccessible>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTextStream>
 
+#include "accessiblepieview.h"
+#include "binarychart.h"
+#include "chartparser.h"
+#include "columnarpiemodel.h"
 #include "mainwindow.h"
+#include "piemodel.h"
+#include "pieview.h"
 
-extern QAccessibleInterface* accessiblePieViewFactory(const QString &classname, QObject *object);
+// Converts a chart between the text and binary formats, as given by the
+// suffix of each file name.
+static bool convertChart(const QString &input, const QString &output)
+{
+    ChartData data;
+    if (BinaryChartFile::isBinaryFileName(input)) {
+        BinaryChartFile file;
+        if (!file.open(input))
+            return false;
+        data = file.chartData();
+    } else if (!readChartFile(input, &data)) {
+        return false;
+    }
+
+    return BinaryChartFile::isBinaryFileName(output) ? BinaryChartFile::write(output, data)
+                                                     : writeChartFile(output, data);
+}
+
+// Returns a chart with the given number of rows, each with a 20 character
+// label, for the checks and measurements below.
+static ChartData generatedChart(int rows)
+{
+    ChartData data;
+    data.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        data.append(QStringLiteral("Category %1").arg(row, 11, 10, QLatin1Char('0')),
+                    1 + row % 100, QColor::fromHsv(row % 360, 255, 255).rgb());
+    }
+    return data;
+}
+
+// Visits every interface below iface the way a screen reader does when it
+// reads the whole chart, and returns how many there were.
+static int walkAccessibleTree(QAccessibleInterface *iface)
+{
+    int visited = 0;
+    const int childCount = iface->childCount();
+    for (int i = 0; i < childCount; ++i) {
+        QAccessibleInterface *child = iface->child(i);
+        child->text(QAccessible::Name);
+        child->state();
+        visited += 1 + walkAccessibleTree(child);
+    }
+    return visited;
+}
+
+// Measures the churn of accessible items for a chart with the given number
+// of rows: the tree is walked twice, then again after removing half of the
+// rows and after reloading the chart. The time taken and the item pool
+// statistics are printed after each walk.
+static void benchmarkAccessibility(int rows, bool columnar, int groupSize)
+{
+    const ChartData data = generatedChart(rows);
+
+    QObject owner;  // outlives the view
+    QAbstractItemModel *model;
+    ChartStorage *storage;
+    if (columnar) {
+        auto columnarModel = new ColumnarPieModel(0, &owner);
+        model = columnarModel;
+        storage = columnarModel;
+    } else {
+        auto pieModel = new PieModel(0, 2, &owner);
+        model = pieModel;
+        storage = pieModel;
+    }
+    storage->setChartData(data);
+
+    PieView view;
+    view.setModel(model);
+    view.setAccessibleGroupSize(groupSize);
+    QAccessibleInterface *iface = QAccessible::queryAccessibleInterface(&view);
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    auto walk = [&](const char *name) {
+        timer.start();
+        const int visited = walkAccessibleTree(iface);
+        const qint64 elapsed = timer.elapsed();
+        const AccessiblePieItem::PoolStats stats = AccessiblePieItem::poolStats();
+        out << name << ": " << visited << " interfaces in " << elapsed << " ms, "
+            << stats.live << " live items, " << stats.capacity << " slots, "
+            << stats.allocations << " allocations, " << stats.recycled << " recycled"
+            << Qt::endl;
+    };
+
+    walk("First walk");
+    walk("Second walk");
+    model->removeRows(0, rows / 2);
+    walk("After removing half");
+    storage->setChartData(data);
+    walk("After reloading");
+}
+
+// Checks rubber-band selection in a generated chart with the given number of
+// rows against testing every item, see PieView::checkSelection(). Some rows
+// are empty and some too thin to see, so every case is covered. Returns the
+// number of rectangles for which the results differ.
+static int checkSelection(int rows)
+{
+    QRandomGenerator random(1);
+    ChartData data = generatedChart(rows);
+    for (double &value : data.values) {
+        const int kind = random.bounded(8);
+        value = kind == 0 ? 0.0 : kind == 1 ? 0.001 : random.bounded(1, 100);
+    }
+
+    PieModel model(0, 2);
+    model.setChartData(data);
+    PieView view;
+    view.setModel(&model);
+
+    const int mismatches = view.checkSelection(1000);
+    QTextStream out(stdout);
+    out << mismatches << " of 1000 rectangles differ" << Qt::endl;
+    return mismatches;
+}
+
+// Returns the resident set size of the process in bytes, or -1 if it can't be
+// read, which is everywhere but Linux.
+static qint64 residentSetSize()
+{
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+    while (!status.atEnd()) {
+        const QByteArray line = status.readLine();
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).simplified().split(' ').first().toLongLong() * 1024;
+    }
+    return -1;
+}
+
+// Measures the memory taken by a generated chart with the given number of
+// rows in one of the models. This is the growth in the resident set size once
+// the chart is in the model and the generated copy of it has been released.
+static int measureMemory(int rows, bool columnar)
+{
+    const qint64 before = residentSetSize();
+    if (before < 0 || rows <= 0) {
+        qWarning("Memory use can only be measured on Linux, for at least one row");
+        return 1;
+    }
+
+    QObject owner;
+    ChartStorage *storage;
+    if (columnar)
+        storage = new ColumnarPieModel(0, &owner);
+    else
+        storage = new PieModel(0, 2, &owner);
+
+    storage->setChartData(generatedChart(rows));
+
+    const qint64 used = residentSetSize() - before;
+    QTextStream out(stdout);
+    out << (columnar ? "ColumnarPieModel" : "PieModel") << ": " << rows << " rows take "
+        << used / (1024 * 1024) << " MiB, " << used / rows << " bytes per row" << Qt::endl;
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
@@ -63,7 +232,85 @@ int main(int argc, char *argv[])
     QAccessible::installFactory(accessiblePieViewFactory);  // Without this line, the application
                                                             // would crash every time we call
                                                             // updateAccessibility() in pieview.cpp
-    MainWindow window;
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption columnarOption("columnar",
+        QCoreApplication::translate("main", "Store the chart in arrays rather than in "
+                                            "QStandardItems. Uses less memory for large charts."));
+    parser.addOption(columnarOption);
+    QCommandLineOption groupOption("group",
+        QCoreApplication::translate("main", "Present the slices to screen readers in groups of "
+                                            "this many, so that huge charts stay navigable."),
+        QCoreApplication::translate("main", "slices"));
+    parser.addOption(groupOption);
+    QCommandLineOption convertOption("convert",
+        QCoreApplication::translate("main", "Convert the input chart to the output chart and exit. "
+                                            "Files ending in .chb are binary, others are text."));
+    parser.addOption(convertOption);
+    QCommandLineOption benchmarkOption("benchmark-a11y",
+        QCoreApplication::translate("main", "Walk the accessible tree of a generated chart with "
+                                            "this many slices, report the time taken and the "
+                                            "accessible item allocations, and exit."),
+        QCoreApplication::translate("main", "slices"));
+    parser.addOption(benchmarkOption);
+    QCommandLineOption checkSelectionOption("check-selection",
+        QCoreApplication::translate("main", "Check rubber-band selection in a generated chart with "
+                                            "this many slices against testing every slice, "
+                                            "and exit."),
+        QCoreApplication::translate("main", "slices"));
+    parser.addOption(checkSelectionOption);
+    QCommandLineOption measureMemoryOption("measure-memory",
+        QCoreApplication::translate("main", "Report the memory taken by a generated chart with "
+                                            "this many slices in the model chosen with "
+                                            "--columnar, and exit."),
+        QCoreApplication::translate("main", "slices"));
+    parser.addOption(measureMemoryOption);
+    QCommandLineOption eventStatsOption("accessible-event-stats",
+        QCoreApplication::translate("main", "On exit, report how many accessibility events were "
+                                            "posted and how many were sent after merging."));
+    parser.addOption(eventStatsOption);
+    parser.addPositionalArgument("input output",
+        QCoreApplication::translate("main", "Charts to convert with --convert."), "[input output]");
+    parser.process(app);
+
+    if (parser.isSet(convertOption)) {
+        const QStringList files = parser.positionalArguments();
+        if (files.size() != 2)
+            parser.showHelp(1);
+        if (!convertChart(files.at(0), files.at(1))) {
+            qWarning("Could not convert %s to %s", qPrintable(files.at(0)), qPrintable(files.at(1)));
+            return 1;
+        }
+        return 0;
+    }
+
+    if (parser.isSet(benchmarkOption)) {
+        benchmarkAccessibility(parser.value(benchmarkOption).toInt(), parser.isSet(columnarOption),
+                               parser.value(groupOption).toInt());
+        return 0;
+    }
+
+    if (parser.isSet(checkSelectionOption))
+        return checkSelection(parser.value(checkSelectionOption).toInt()) == 0 ? 0 : 1;
+
+    if (parser.isSet(measureMemoryOption)) {
+        return measureMemory(parser.value(measureMemoryOption).toInt(),
+                             parser.isSet(columnarOption));
+    }
+
+    MainWindow window(parser.isSet(columnarOption) ? MainWindow::ColumnarModel
+                                                   : MainWindow::StandardItemModel);
+    if (parser.isSet(groupOption))
+        window.setAccessibleGroupSize(parser.value(groupOption).toInt());
     window.show();
-    return app.exec();
+    const int result = app.exec();
+
+    if (parser.isSet(eventStatsOption)) {
+        const AccessibleEventQueue::Stats stats = window.accessibleEventStats();
+        QTextStream out(stdout);
+        out << "Accessibility events: " << stats.posted << " posted, " << stats.sent << " sent"
+            << Qt::endl;
+    }
+    return result;
 }
@@ -48,30 +48,61 @@
 **
 ****************************************************************************/
 
+#include "binarychart.h"
+#include "chartdiff.h"
+#include "chartfollower.h"
+#include "chartjournal.h"
+#include "chartloader.h"
+#include "chartparser.h"
+#include "columnarpiemodel.h"
 #include "piemodel.h"
 #include "pieview.h"
 #include "mainwindow.h"
 #include "accessiblepieview.h"
 
+#include <QtConcurrent>
 #include <QtWidgets>
 
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(ModelType modelType, QWidget *parent)
     : QMainWindow(parent)
 {
     QMenu *fileMenu = new QMenu(tr("&File"), this);
     QAction *openAction = fileMenu->addAction(tr("&Open..."));
     openAction->setShortcuts(QKeySequence::Open);
+    QAction *reloadAction = fileMenu->addAction(tr("&Reload"));
+    reloadAction->setShortcuts(QKeySequence::Refresh);
     QAction *saveAction = fileMenu->addAction(tr("&Save As..."));
     saveAction->setShortcuts(QKeySequence::SaveAs);
+    cancelLoadAction = fileMenu->addAction(tr("&Cancel Loading"));
+    cancelLoadAction->setShortcuts(QKeySequence::Cancel);
+    cancelLoadAction->setEnabled(false);
+    followAction = fileMenu->addAction(tr("&Follow File"));
+    followAction->setCheckable(true);
+    followAction->setStatusTip(tr("Add lines to the chart as they are written to the file"));
     QAction *quitAction = fileMenu->addAction(tr("E&xit"));
     quitAction->setShortcuts(QKeySequence::Quit);
 
-    setupModel();
+    setupModel(modelType);
     setupViews();
 
+    loader = new ChartLoader(this);
+    journal = new ChartJournal(model, storage, this);
+    follower = new ChartFollower(model, storage, this);
+    appendTimer = new QTimer(this);
+    appendTimer->setInterval(40);
+
     connect(openAction, &QAction::triggered, this, &MainWindow::openFile);
+    connect(reloadAction, &QAction::triggered, this, &MainWindow::reloadFile);
     connect(saveAction, &QAction::triggered, this, &MainWindow::saveFile);
     connect(quitAction, &QAction::triggered, qApp, &QCoreApplication::quit);
+    connect(cancelLoadAction, &QAction::triggered, this, &MainWindow::cancelLoad);
+    connect(loader, &ChartLoader::opened, this, &MainWindow::loadOpened);
+    connect(loader, &ChartLoader::rowsLoaded, this, &MainWindow::loadRows);
+    connect(loader, &ChartLoader::finished, this, &MainWindow::loadFinished);
+    connect(appendTimer, &QTimer::timeout, this, &MainWindow::appendPendingRows);
+    connect(followAction, &QAction::toggled, this, &MainWindow::setFollowing);
+    connect(follower, &ChartFollower::fileReplaced, this, &MainWindow::loadFile);
+    connect(&saveWatcher, &QFutureWatcher<bool>::finished, this, &MainWindow::saveFinished);
 
     menuBar()->addMenu(fileMenu);
     statusBar();
@@ -82,9 +113,35 @@ MainWindow::MainWindow(QWidget *parent)
     resize(870, 550);
 }
 
-void MainWindow::setupModel()
+/*
+    Groups the slices for screen readers, see PieView::setAccessibleGroupSize().
+*/
+
+void MainWindow::setAccessibleGroupSize(int rows)
+{
+    static_cast<PieView*>(pieChart)->setAccessibleGroupSize(rows);
+}
+
+/*
+    Returns how many accessibility events the chart has posted and sent.
+*/
+
+AccessibleEventQueue::Stats MainWindow::accessibleEventStats() const
+{
+    return static_cast<PieView*>(pieChart)->accessibleEventQueue()->stats();
+}
+
+void MainWindow::setupModel(ModelType modelType)
 {
-    model = new PieModel(8, 2, this);
+    if (modelType == ColumnarModel) {
+        auto columnarModel = new ColumnarPieModel(8, this);
+        model = columnarModel;
+        storage = columnarModel;
+    } else {
+        auto pieModel = new PieModel(8, 2, this);
+        model = pieModel;
+        storage = pieModel;
+    }
     model->setHeaderData(0, Qt::Horizontal, tr("Label"));
     model->setHeaderData(1, Qt::Horizontal, tr("Quantity"));
 }
@@ -120,72 +177,297 @@ void MainWindow::setupViews()
 void MainWindow::openFile()
 {
     const QString fileName =
-        QFileDialog::getOpenFileName(this, tr("Choose a data file"), "", "*.cht");
+        QFileDialog::getOpenFileName(this, tr("Choose a data file"), "",
+                                     tr("Charts (*.cht *.chb);;Text charts (*.cht);;"
+                                        "Binary charts (*.chb)"));
     if (!fileName.isEmpty())
         loadFile(fileName);
 }
 
 void MainWindow::loadFile(const QString &fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QFile::ReadOnly | QFile::Text))
+    // Loading the file that is already shown only changes the rows that
+    // differ, once the whole file has been read.
+    reloading = !loadedFileName.isEmpty() && fileName == loadedFileName;
+
+    // The chart that is shown stays tied to its file, and keeps being
+    // autosaved, until the new file turns out to be readable.
+    loader->cancel();
+    appendTimer->stop();
+    loadingFileName = fileName;
+    pendingRows = ChartData();
+    pendingOffset = 0;
+    bytesTotal = 0;
+    bytesLoaded = 0;
+
+    if (BinaryChartFile::isBinaryFileName(fileName)) {
+        loadBinaryFile(fileName);
         return;
+    }
+
+    loader->load(fileName);
+    cancelLoadAction->setEnabled(true);
+    statusBar()->showMessage(tr("Loading %1...").arg(fileName));
+}
 
-    QTextStream stream(&file);
+/*
+    Binary files need no parsing. ColumnarPieModel reads them in place, while
+    other models are given the rows a batch at a time, as for text files.
+*/
 
-    model->removeRows(0, model->rowCount(QModelIndex()), QModelIndex());
+void MainWindow::loadBinaryFile(const QString &fileName)
+{
+    BinaryChartFile file;
+    if (!file.open(fileName)) {
+        statusBar()->showMessage(tr("Could not open %1").arg(fileName), 2000);
+        return;
+    }
 
-    int row = 0;
-    while (!stream.atEnd()) {
-        const QString line = stream.readLine();
-        if (!line.isEmpty()) {
-            model->insertRows(row, 1, QModelIndex());
+    releaseLoadedFile();
 
-            const QStringList pieces = line.split(QLatin1Char(','));
-            if (pieces.size() < 3)
-                continue;
+    if (reloading) {
+        updateChart(model, storage, storage->chartData(), file.chartData());
+        finishLoad();
+        return;
+    }
+
+    if (auto columnarModel = qobject_cast<ColumnarPieModel*>(model)) {
+        if (columnarModel->setChartFile(fileName))
+            finishLoad();
+        else
+            statusBar()->showMessage(tr("Could not open %1").arg(fileName), 2000);
+        return;
+    }
 
-            model->setData(model->index(row, 0, QModelIndex()),
-                           pieces.value(0));
-            model->setData(model->index(row, 1, QModelIndex()),
-                           pieces.value(1));
-            model->setData(model->index(row, 0, QModelIndex()),
-                           QColor(pieces.value(2)), Qt::DecorationRole);
-            row++;
+    storage->setChartData(ChartData());
+    pendingRows = file.chartData();
+    bytesTotal = 1;     // the whole file has been read
+    bytesLoaded = 1;
+    cancelLoadAction->setEnabled(true);
+    appendTimer->start();
+}
+
+void MainWindow::reloadFile()
+{
+    if (!loadedFileName.isEmpty())
+        loadFile(loadedFileName);
+}
+
+void MainWindow::cancelLoad()
+{
+    loader->cancel();
+    appendTimer->stop();
+    pendingRows = ChartData();
+    pendingOffset = 0;
+    cancelLoadAction->setEnabled(false);
+    statusBar()->showMessage(tr("Canceled loading %1").arg(loadingFileName), 2000);
+}
+
+void MainWindow::loadOpened(qint64 size)
+{
+    // The old chart stays until we know that the new one can be read. When
+    // reloading, it stays until the changed rows are applied.
+    if (!reloading) {
+        releaseLoadedFile();
+        storage->setChartData(ChartData());
+    }
+    bytesTotal = size;
+    appendTimer->start();
+}
+
+void MainWindow::loadRows(const ChartData &rows, qint64 bytes)
+{
+    if (pendingOffset == pendingRows.size()) {
+        pendingRows = rows;
+        pendingOffset = 0;
+    } else {
+        pendingRows.append(rows);
+    }
+    bytesLoaded = bytes;
+}
+
+void MainWindow::loadFinished(bool ok)
+{
+    if (ok)
+        return; // appendPendingRows() finishes up once every row is added
+
+    cancelLoadAction->setEnabled(false);
+    statusBar()->showMessage(tr("Could not open %1").arg(loadingFileName), 2000);
+}
+
+/*
+    Adds the next batch of loaded rows to the model. Called by a timer, so the
+    number of rows added per second is bounded and PieView can paint the
+    partial chart in between.
+*/
+
+void MainWindow::appendPendingRows()
+{
+    if (reloading) {
+        if (loader->isLoading()) {
+            const int percent = bytesTotal > 0 ? int(100 * bytesLoaded / bytesTotal) : 0;
+            statusBar()->showMessage(tr("Reloading %1... %2%").arg(loadingFileName).arg(percent));
+            return;
         }
+
+        appendTimer->stop();
+        releaseLoadedFile();
+        updateChart(model, storage, storage->chartData(), pendingRows);
+        pendingRows = ChartData();
+        cancelLoadAction->setEnabled(false);
+        finishLoad();
+        return;
+    }
+
+    const int maximumRows = 50000;
+    const int rows = qMin(maximumRows, pendingRows.size() - pendingOffset);
+    if (rows > 0) {
+        storage->appendChartData(pendingRows.mid(pendingOffset, rows));
+        pendingOffset += rows;
+    }
+
+    if (pendingOffset < pendingRows.size() || loader->isLoading()) {
+        const int percent = bytesTotal > 0 ? int(100 * bytesLoaded / bytesTotal) : 0;
+        statusBar()->showMessage(tr("Loading %1... %2%").arg(loadingFileName).arg(percent));
+        return;
+    }
+
+    appendTimer->stop();
+    pendingRows = ChartData();
+    pendingOffset = 0;
+    cancelLoadAction->setEnabled(false);
+    finishLoad();
+}
+
+/*
+    Called once the whole file is in the model. Applies any changes that were
+    autosaved to the file's journal, and autosaves further changes.
+*/
+
+void MainWindow::finishLoad()
+{
+    setLoadedFile(loadingFileName, bytesTotal);
+    if (followAction->isChecked()) {
+        setFollowing(true);
+        return;
+    }
+
+    const int changes = journal->open(loadingFileName);
+    if (changes > 0)
+        statusBar()->showMessage(tr("Loaded %1 and restored %n autosaved change(s)", "", changes)
+                                 .arg(loadingFileName), 2000);
+    else
+        statusBar()->showMessage(tr("Loaded %1").arg(loadingFileName), 2000);
+}
+
+/*
+    The chart is tied to the file it was last loaded from or saved to, which
+    is the file that is reloaded, followed and autosaved to. size is the size
+    of the file when the chart was read from it or written to it.
+*/
+
+void MainWindow::setLoadedFile(const QString &fileName, qint64 size)
+{
+    loadedFileName = fileName;
+    loadedFileSize = size;
+}
+
+// Stops autosaving and following the chart that is shown, which is about to
+// be replaced.
+void MainWindow::releaseLoadedFile()
+{
+    journal->close();
+    follower->stop();
+    loadedFileName.clear();
+    savingLoadedChart = false;
+}
+
+/*
+    Starts or stops following the loaded file. A file that is being followed
+    is still being written by another program, so changes to the chart are
+    not autosaved to it until following stops.
+*/
+
+void MainWindow::setFollowing(bool follow)
+{
+    if (!follow) {
+        follower->stop();
+        if (!loadedFileName.isEmpty())
+            journal->open(loadedFileName);
+        return;
+    }
+
+    // A file that is still loading is followed once finishLoad() is called.
+    if (loadedFileName.isEmpty())
+        return;
+
+    if (loadedFileName.startsWith(QLatin1Char(':'))
+            || BinaryChartFile::isBinaryFileName(loadedFileName)) {
+        const QSignalBlocker blocker(followAction);
+        followAction->setChecked(false);
+        journal->open(loadedFileName);
+        statusBar()->showMessage(tr("Only text charts loaded from disk can be followed"), 2000);
+        return;
     }
 
-    file.close();
-    statusBar()->showMessage(tr("Loaded %1").arg(fileName), 2000);
+    journal->close();
+    follower->follow(loadedFileName, loadedFileSize);
+    statusBar()->showMessage(tr("Following %1").arg(loadedFileName), 2000);
 }
 
 void MainWindow::saveFile()
 {
+    // Check before asking for a file name, so that the choice isn't wasted.
+    if (saveWatcher.isRunning()) {
+        statusBar()->showMessage(tr("A save is still in progress"), 2000);
+        return;
+    }
+
+    QString selectedFilter;
     QString fileName = QFileDialog::getSaveFileName(this,
-        tr("Save file as"), "", "*.cht");
+        tr("Save file as"), "", tr("Text charts (*.cht);;Binary charts (*.chb)"),
+        &selectedFilter);
 
     if (fileName.isEmpty())
         return;
 
-    QFile file(fileName);
-    if (!file.open(QFile::WriteOnly | QFile::Text))
-        return;
-
-    QTextStream stream(&file);
-    for (int row = 0; row < model->rowCount(QModelIndex()); ++row) {
+    bool binary = BinaryChartFile::isBinaryFileName(fileName);
+    if (QFileInfo(fileName).suffix().isEmpty()) {
+        binary = selectedFilter.contains(QLatin1String("*.chb"));
+        fileName += binary ? QLatin1String(".chb") : QLatin1String(".cht");
+    }
 
-        QStringList pieces;
+    if (saveWatcher.isRunning() || !journal->beginRebase()) {
+        statusBar()->showMessage(tr("A save is still in progress"), 2000);
+        return;
+    }
 
-        pieces.append(model->data(model->index(row, 0, QModelIndex()),
-                                  Qt::DisplayRole).toString());
-        pieces.append(model->data(model->index(row, 1, QModelIndex()),
-                                  Qt::DisplayRole).toString());
-        pieces.append(model->data(model->index(row, 0, QModelIndex()),
-                                  Qt::DecorationRole).toString());
+    // The copy is taken here so that it is consistent, even if the chart is
+    // edited while it is being written. Each writer only replaces the file
+    // once it is complete.
+    const ChartData data = storage->chartData();
+    const auto write = binary ? &BinaryChartFile::write : &writeChartFile;
+    storage->releaseFile(fileName);
+    savingFileName = fileName;
+    savingLoadedChart = true;
+    saveWatcher.setFuture(QtConcurrent::run(write, fileName, data));
+    statusBar()->showMessage(tr("Saving %1...").arg(fileName));
+}
 
-        stream << pieces.join(',') << "\n";
+void MainWindow::saveFinished()
+{
+    const bool saved = saveWatcher.result();
+    journal->endRebase(saved, savingFileName);
+    if (!saved) {
+        statusBar()->showMessage(tr("Could not save %1").arg(savingFileName), 2000);
+        return;
     }
 
-    file.close();
-    statusBar()->showMessage(tr("Saved %1").arg(fileName), 2000);
+    // The chart now comes from the saved file, as does its journal, unless
+    // another file was loaded meanwhile. A followed chart stays tied to the
+    // file that is being written.
+    if (savingLoadedChart && !followAction->isChecked())
+        setLoadedFile(savingFileName, QFileInfo(savingFileName).size());
+    savingLoadedChart = false;
+    statusBar()->showMessage(tr("Saved %1").arg(savingFileName), 2000);
 }
@@ -51,31 +51,86 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "accessibleeventqueue.h"
+#include "chartdata.h"
+
+#include <QFutureWatcher>
 #include <QMainWindow>
 
 QT_BEGIN_NAMESPACE
+class QAction;
 class QAbstractItemModel;
 class QAbstractItemView;
+class QTimer;
 QT_END_NAMESPACE
 
+class ChartFollower;
+class ChartJournal;
+class ChartLoader;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    enum ModelType {
+        StandardItemModel,  // PieModel, one QStandardItem per cell
+        ColumnarModel,      // ColumnarPieModel, for very large charts
+    };
+
+    MainWindow(ModelType modelType = StandardItemModel, QWidget *parent = nullptr);
+
+    void setAccessibleGroupSize(int rows);
+    AccessibleEventQueue::Stats accessibleEventStats() const;
 
 private slots:
     void openFile();
     void saveFile();
+    void saveFinished();
+    void reloadFile();
+    void cancelLoad();
+    void loadOpened(qint64 size);
+    void loadRows(const ChartData &rows, qint64 bytes);
+    void loadFinished(bool ok);
+    void appendPendingRows();
+    void setFollowing(bool follow);
 
 private:
-    void setupModel();
+    void setupModel(ModelType modelType);
     void setupViews();
     void loadFile(const QString &path);
+    void loadBinaryFile(const QString &fileName);
+    void finishLoad();
+    void setLoadedFile(const QString &fileName, qint64 size);
+    void releaseLoadedFile();
 
     QAbstractItemModel *model = nullptr;
+    ChartStorage *storage = nullptr;    // the same model
     QAbstractItemView *pieChart = nullptr;
+
+    // Files are loaded in the background. The rows are added to the model a
+    // batch at a time, so that the window stays responsive while they are.
+    ChartLoader *loader = nullptr;
+    QTimer *appendTimer = nullptr;
+    QAction *cancelLoadAction = nullptr;
+
+    ChartFollower *follower = nullptr;
+    QAction *followAction = nullptr;
+    QString loadingFileName;
+    QString loadedFileName;     // set once the whole file is in the model
+    qint64 loadedFileSize = 0;  // its size when it was read or written
+    bool reloading = false;     // loadingFileName is loadedFileName again
+    ChartData pendingRows;      // loaded but not yet added to the model
+    int pendingOffset = 0;      // rows before this were added already
+    qint64 bytesTotal = 0;      // the size of the file when it was opened
+    qint64 bytesLoaded = 0;
+
+    // Files are saved in the background, from a copy of the chart. Changes
+    // in between saves are autosaved to a journal.
+    ChartJournal *journal = nullptr;
+    QFutureWatcher<bool> saveWatcher;
+    QString savingFileName;
+    bool savingLoadedChart = false;     // the chart being saved is still shown
 };
 
 #endif // MAINWINDOW_H
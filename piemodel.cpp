@@ -31,8 +31,6 @@
 
 #include "piemodel.h"
 
-#include "accessiblepieview.h"
-
 PieItem::PieItem()
 : QStandardItem()
 {
@@ -43,26 +41,11 @@ PieItem::PieItem(const PieItem& other)
 {
 }
 
-PieItem::~PieItem()
-{
-    deleteAccessibleInterface();
-}
-
 QStandardItem* PieItem::clone() const
 {
     return new PieItem(*this);
 }
 
-void PieItem::deleteAccessibleInterface()
-{
-    auto iface = data(AccessibleInterfaceRole).value<AccessiblePieItem*>();
-    if (!iface)
-        return;
-    QAccessible::Id id = QAccessible::uniqueId(iface);
-    QAccessible::deleteAccessibleInterface(id);
-    setData(QVariant(), AccessibleInterfaceRole); // unset data
-}
-
 int PieItem::type() const
 {
     return PieItemType;
@@ -74,21 +57,67 @@ PieModel::PieModel(int rows, int columns, QObject *parent)
     setItemPrototype(new PieItem());
 }
 
-bool PieModel::removeRows(int startRow, int count, const QModelIndex &parent)
+void PieModel::setChartData(const ChartData &data)
+{
+    // QStandardItemModel announces every row and item it changes. Views only
+    // need to hear about the reset, so silence the rest.
+    beginResetModel();
+    blockSignals(true);
+    setRowCount(0);
+    setRowCount(data.size());
+    fillRows(0, data);
+    blockSignals(false);
+    endResetModel();
+}
+
+void PieModel::insertChartData(int row, const ChartData &data)
 {
-    Q_ASSERT(0 <= startRow && startRow < rowCount(parent));
-    const int endRow = startRow + count - 1;
-    Q_ASSERT(startRow <= endRow && endRow < rowCount(parent));
+    if (data.size() == 0)
+        return;
+
+    // insertRows() announces the empty rows as one insertion. As above, the
+    // items are then filled in silently, and announced as one change.
+    insertRows(row, data.size());
+    blockSignals(true);
+    fillRows(row, data);
+    blockSignals(false);
+    emit dataChanged(index(row, 0), index(row + data.size() - 1, columnCount() - 1),
+                     { Qt::DisplayRole, Qt::DecorationRole });
+}
+
+void PieModel::appendChartData(const ChartData &data)
+{
+    insertChartData(rowCount(), data);
+}
 
-    for (int row = startRow; row <= endRow; ++row) {
-        for (int column = 0; column < columnCount(parent); ++column) {
-            QStandardItem* itm = item(row, column);
-            if (!itm)
-                continue;
-            Q_ASSERT(dynamic_cast<PieItem*>(itm) != nullptr);
-            static_cast<PieItem*>(itm)->deleteAccessibleInterface();
-        }
+ChartData PieModel::chartData() const
+{
+    ChartData data;
+    data.reserve(rowCount());
+    for (int row = 0; row < rowCount(); ++row) {
+        const QStandardItem *label = item(row, 0);
+        const QStandardItem *value = item(row, 1);
+        const QColor color = label ? qvariant_cast<QColor>(label->data(Qt::DecorationRole))
+                                   : QColor();
+        data.append(label ? label->text() : QString(),
+                    value ? value->data(Qt::DisplayRole).toDouble() : 0.0,
+                    color.isValid() ? color.rgba() : 0);
     }
+    return data;
+}
 
-    return QStandardItemModel::removeRows(startRow, count, parent);
+// Creates the items for data in the empty rows from startRow onwards.
+void PieModel::fillRows(int startRow, const ChartData &data)
+{
+    for (int i = 0; i < data.size(); ++i) {
+        auto label = new PieItem();
+        label->setData(data.labels.at(i), Qt::DisplayRole);
+        if (data.colors.at(i) != 0)
+            label->setData(QColor::fromRgba(data.colors.at(i)), Qt::DecorationRole);
+        setItem(startRow + i, 0, label);
+
+        auto value = new PieItem();
+        value->setData(data.values.at(i), Qt::DisplayRole);
+        setItem(startRow + i, 1, value);
+    }
 }
@@ -32,18 +32,12 @@
 #ifndef PIEMODEL_H
 #define PIEMODEL_H
 
+#include "chartdata.h"
+
 #include <QStandardItemModel>
 
 class PieView;
 
-// Custom data roles to use alongside Qt::ItemDataRole.
-// See https://doc.qt.io/qt-5/qt.html#ItemDataRole-enum
-enum ItemDataRole {
-    AccessibleInterfaceRole = Qt::UserRole,
-    // AnotherRole,
-    // YetAnotherRole,
-};
-
 // Custom item types to use alongside QStandardItem::ItemType.
 // See https://doc.qt.io/qt-5/qstandarditem.html#ItemType-enum
 enum ItemType {
@@ -56,22 +50,27 @@ class PieItem : public QStandardItem
 {
 public:
     PieItem();
-    ~PieItem() override;
     QStandardItem* clone() const override;
-    void deleteAccessibleInterface();
     int type() const override;
 
 protected:
     PieItem(const PieItem& other);
 };
 
-class PieModel : public QStandardItemModel
+class PieModel : public QStandardItemModel, public ChartStorage
 {
     Q_OBJECT
 
 public:
     PieModel(int rows, int columns, QObject *parent = nullptr);
-    bool removeRows(int startRow, int count, const QModelIndex &parent = QModelIndex());
+
+    void setChartData(const ChartData &data) override;
+    void insertChartData(int row, const ChartData &data) override;
+    void appendChartData(const ChartData &data) override;
+    ChartData chartData() const override;
+
+private:
+    void fillRows(int startRow, const ChartData &data);
 };
 
 #endif // PIEMODEL_H
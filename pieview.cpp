@@ -50,10 +50,15 @@
 
 #include "pieview.h"
 
+#include "accessibleeventqueue.h"
+
 #include <QtWidgets>
 
+#include <algorithm>
+
 PieView::PieView(QWidget *parent)
     : QAbstractItemView(parent)
+    , accessibleEvents(new AccessibleEventQueue(this))
 {
     setAccessibleName("Pie View");
     setAccessibleDescription("Pie chart with key");
@@ -62,10 +67,36 @@ PieView::PieView(QWidget *parent)
     setTabKeyNavigation(true); // enable Tab and Backtab in `moveCursor()`
 }
 
+void PieView::changeEvent(QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::PaletteChange:
+    case QEvent::FontChange:
+    case QEvent::StyleChange:
+        baseLayerValid = false;
+        updateGeometries();
+        viewport()->update();
+        break;
+    default:
+        break;
+    }
+
+    QAbstractItemView::changeEvent(event);
+}
+
 void PieView::currentChanged(const QModelIndex &current, const QModelIndex &previous)
 {
     QAbstractItemView::currentChanged(current, previous);
 
+    // The base class only repaints visualRect() of each index, but the focus
+    // pattern of a slice covers its whole wedge.
+    for (const QModelIndex &index : { previous, current }) {
+        if (index.isValid() && index.column() == 1) {
+            int slot = rowSlots.value(index.row(), -1);
+            viewport()->update(sliceHighlightRegion(slot, slot + 1));
+        }
+    }
+
     if (!current.isValid())
         return;
 
@@ -77,15 +108,9 @@ void PieView::currentChanged(const QModelIndex &current, const QModelIndex &prev
     // Debug build: always create events (helps detect possible crashes).
     {
 #endif
-        int child = current.row() * model()->columnCount() + current.column();
-        qDebug() << "Creating accessibility event for PieView: Focus child" << child;
-        QAccessibleEvent event(this, QAccessible::Focus);
-        event.setChild(child);
-        QAccessible::updateAccessibility(&event);
-        // Note: if crashes do happen, they are likely to occur in Qt or screen reader code that
-        // is outside our control. It might not be obvious that the crash was caused by our code,
-        // or even that is was related to accessibility, hence the need to print a debug
-        // statement before creating the event and calling updateAccessibility().
+        // Events are sent on the next turn of the event loop, so that holding
+        // down an arrow key doesn't flood the screen reader with them.
+        accessibleEvents->post(QAccessible::Focus, current);
     }
 }
 
@@ -101,19 +126,26 @@ void PieView::selectionChanged(const QItemSelection &selected, const QItemSelect
     // Debug build: always create events (helps detect possible crashes).
     {
 #endif
+        // Selecting or deselecting lots of items at once, e.g. with Ctrl+A, is
+        // announced as a single change rather than item by item.
+        int count = 0;
+        for (const QItemSelectionRange &range : selected)
+            count += range.height() * range.width();
+        for (const QItemSelectionRange &range : deselected)
+            count += range.height() * range.width();
+        if (count > AccessibleEventQueue::MaxSelectionEvents) {
+            accessibleEvents->postSelectionWithin();
+            return;
+        }
+
         QModelIndex current = currentIndex();
         bool currentSelected = selected.contains(current);
 
         if (currentSelected || deselected.contains(current)) {
-            int child = current.row() * model()->columnCount() + current.column();
-            qDebug() << "Creating accessibility event for PieView:"
-                << (currentSelected ? "Selected" : "Deselected")
-                << "child" << child;
             // Tried to use QAccessibleStateChangeEvent but it was ignored by screen readers.
-            QAccessibleEvent event(this,
-                currentSelected ? QAccessible::SelectionAdd : QAccessible::SelectionRemove);
-            event.setChild(child);
-            QAccessible::updateAccessibility(&event);
+            accessibleEvents->post(
+                currentSelected ? QAccessible::SelectionAdd : QAccessible::SelectionRemove,
+                current);
         }
     }
 }
@@ -124,23 +156,22 @@ void PieView::dataChanged(const QModelIndex &topLeft,
 {
     QAbstractItemView::dataChanged(topLeft, bottomRight, roles);
 
-    if (!roles.contains(Qt::DisplayRole))
-        return;
-
-    validItems = 0;
-    totalValue = 0.0;
-
-    for (int row = 0; row < model()->rowCount(rootIndex()); ++row) {
+    // Labels and colors are drawn in the base layer too.
+    if (roles.isEmpty() || roles.contains(Qt::DisplayRole)
+            || roles.contains(Qt::DecorationRole)) {
+        baseLayerValid = false;
+        viewport()->update();
+    }
 
-        QModelIndex index = model()->index(row, 1, rootIndex());
-        double value = model()->data(index, Qt::DisplayRole).toDouble();
+    if (!roles.isEmpty() && !roles.contains(Qt::DisplayRole))
+        return;
 
-        if (value > 0.0) {
-            totalValue += value;
-            validItems++;
-        }
+    // Only the rows in the changed range need to be looked at. Their values
+    // are applied to the total as differences from the values we last saw.
+    if (topLeft.column() <= 1 && 1 <= bottomRight.column()) {
+        updateSlots(topLeft.row(), bottomRight.row());
+        updateGeometries();
     }
-    viewport()->update();
 
 #if defined(NDEBUG)
     // Release build: only create events when screen reader is running.
@@ -159,12 +190,9 @@ void PieView::dataChanged(const QModelIndex &topLeft,
                 && topLeft.column() <= current.column()
                 && current.column() <= bottomRight.column()) {
             // Data was changed for current index.
-            int child = current.row() * model()->columnCount() + current.column();
-            qDebug() << "Creating accessibility event for PieView: Updated child" << child;
-            QAccessibleEvent event(this, QAccessible::Focus); // Focus seems to be the only event
-                                                              // type that screen readers notice.
-            event.setChild(child);
-            QAccessible::updateAccessibility(&event);
+            accessibleEvents->post(QAccessible::Focus, current); // Focus seems to be the only
+                                                                 // event type that screen
+                                                                 // readers notice.
         }
     }
 }
@@ -183,7 +211,7 @@ bool PieView::edit(const QModelIndex &index, EditTrigger trigger, QEvent *event)
 
 QModelIndex PieView::indexAt(const QPoint &point) const
 {
-    if (validItems == 0)
+    if (sliceRows.isEmpty())
         return QModelIndex();
 
     // Transform the view coordinates into contents widget coordinates.
@@ -205,40 +233,21 @@ QModelIndex PieView::indexAt(const QPoint &point) const
         if (angle < 0)
             angle = 360 + angle;
 
-        // Find the relevant slice of the pie.
-        double startAngle = 0.0;
-
-        for (int row = 0; row < model()->rowCount(rootIndex()); ++row) {
-
-            QModelIndex index = model()->index(row, 1, rootIndex());
-            double value = model()->data(index).toDouble();
+        // Find the relevant slice of the pie. The slices are sorted by their
+        // start angle, so we can use a binary search.
+        int slice = sliceAt(angle);
 
-            if (value > 0.0) {
-                double sliceAngle = 360 * value / totalValue;
-
-                if (angle >= startAngle && angle < (startAngle + sliceAngle))
-                    return model()->index(row, 1, rootIndex());
-
-                startAngle += sliceAngle;
-            }
-        }
+        // Thin slices are drawn merged into wedges, but the slice that is
+        // hit is still the one under the point. The merged color is only
+        // used for painting.
+        if (slice >= 0 && slice < sliceRows.size())
+            return model()->index(sliceRows.at(slice), 1, rootIndex());
     } else {
         double itemHeight = QFontMetrics(viewOptions().font).height();
         int listItem = int((wy - margin) / itemHeight);
-        int validRow = 0;
-
-        for (int row = 0; row < model()->rowCount(rootIndex()); ++row) {
-
-            QModelIndex index = model()->index(row, 1, rootIndex());
-            if (model()->data(index).toDouble() > 0.0) {
-
-                if (listItem == validRow)
-                    return model()->index(row, 0, rootIndex());
 
-                // Update the list index that corresponds to the next valid row.
-                ++validRow;
-            }
-        }
+        if (listItem >= 0 && listItem < sliceRows.size())
+            return model()->index(sliceRows.at(listItem), 0, rootIndex());
     }
 
     return QModelIndex();
@@ -261,32 +270,18 @@ QRect PieView::itemRect(const QModelIndex &index) const
 
     // Check whether the index's row is in the list of rows represented
     // by slices.
-    QModelIndex valueIndex;
-
-    if (index.column() != 1)
-        valueIndex = model()->index(index.row(), 1, rootIndex());
-    else
-        valueIndex = index;
-
-    if (model()->data(valueIndex).toDouble() <= 0.0)
+    int listItem = rowSlots.value(index.row(), -1);
+    if (listItem < 0)
         return QRect();
 
-    int listItem = 0;
-    for (int row = index.row()-1; row >= 0; --row) {
-        if (model()->data(model()->index(row, 1, rootIndex())).toDouble() > 0.0)
-            listItem++;
-    }
-
     switch (index.column()) {
     case 0: {
         const qreal itemHeight = QFontMetricsF(viewOptions().font).height();
 
-        return QRect(totalSize,
-                     qRound(margin + listItem * itemHeight),
-                     totalSize - margin, qRound(itemHeight));
+        return keyRect(listItem, itemHeight);
     }
     case 1:
-        return itemRegion(index).boundingRect();
+        return sliceGeometry(listItem).bounds;
     }
     return QRect();
 }
@@ -299,33 +294,54 @@ QRegion PieView::itemRegion(const QModelIndex &index) const
     if (index.column() != 1)
         return itemRect(index);
 
-    if (model()->data(index).toDouble() <= 0.0)
+    int slot = rowSlots.value(index.row(), -1);
+    if (slot < 0)
         return QRegion();
 
-    double startAngle = 0.0;
-    for (int row = 0; row < model()->rowCount(rootIndex()); ++row) {
+    return sliceGeometry(slot).region;
+}
 
-        QModelIndex sliceIndex = model()->index(row, 1, rootIndex());
-        double value = model()->data(sliceIndex).toDouble();
+/*
+    Returns the rectangle of the key item in \a slot in contents coordinates.
+*/
 
-        if (value > 0.0) {
-            double angle = 360 * value / totalValue;
+QRect PieView::keyRect(int slot, qreal itemHeight) const
+{
+    return QRect(totalSize,
+                 qRound(margin + slot * itemHeight),
+                 totalSize - margin, qRound(itemHeight));
+}
 
-            if (sliceIndex == index) {
-                QPainterPath slicePath;
-                slicePath.moveTo(totalSize / 2, totalSize / 2);
-                slicePath.arcTo(margin, margin, margin + pieSize, margin + pieSize,
-                                startAngle, angle);
-                slicePath.closeSubpath();
+/*
+    Returns the shape of the slice in \a slot in contents coordinates. Shapes
+    are cached until the layout changes, because building them is expensive
+    and selection and accessibility ask for the same ones over and over.
+*/
 
-                return QRegion(slicePath.toFillPolygon().toPolygon());
-            }
+const PieView::SliceGeometry &PieView::sliceGeometry(int slot) const
+{
+    updateAngles();
+    if (sliceGeometries.size() != sliceRows.size())
+        sliceGeometries.resize(sliceRows.size());
 
-            startAngle += angle;
-        }
+    SliceGeometry &geometry = sliceGeometries[slot];
+
+    if (geometry.generation != layoutGeneration) {
+        double startAngle = sliceAngles.at(slot);
+        double angle = sliceAngles.at(slot + 1) - startAngle;
+
+        QPainterPath slicePath;
+        slicePath.moveTo(totalSize / 2, totalSize / 2);
+        slicePath.arcTo(margin, margin, margin + pieSize, margin + pieSize,
+                        startAngle, angle);
+        slicePath.closeSubpath();
+
+        geometry.region = QRegion(slicePath.toFillPolygon().toPolygon());
+        geometry.bounds = geometry.region.boundingRect();
+        geometry.generation = layoutGeneration;
     }
 
-    return QRegion();
+    return geometry;
 }
 
 int PieView::horizontalOffset() const
@@ -363,165 +379,321 @@ QModelIndex PieView::moveCursor(QAbstractItemView::CursorAction cursorAction,
 {
     QModelIndex current = currentIndex();
 
+    // Only rows that are drawn as slices can be navigated to.
+    if (sliceRows.isEmpty())
+        return QModelIndex();
+
     if (!current.isValid())
         cursorAction = MoveHome;
 
+    // Find the slots either side of the current row. If the current row is
+    // drawn then these are simply the slots before and after its own slot.
+    int lastSlot = sliceRows.size() - 1;
+    int previousSlot = 0;
+    int nextSlot = 0;
+    if (current.isValid()) {
+        int slot = rowSlots.value(current.row(), -1);
+        if (slot >= 0) {
+            previousSlot = slot - 1;
+            nextSlot = slot + 1;
+        } else {
+            nextSlot = firstSlotFrom(current.row());
+            previousSlot = nextSlot - 1;
+        }
+    }
+
     switch (cursorAction) {
         case MoveLeft:
         case MoveUp:
-            if (current.row() > 0)
-                current = model()->index(current.row() - 1, current.column(),
-                                         rootIndex());
-            else
-                current = model()->index(0, current.column(), rootIndex());
+            current = model()->index(sliceRows.at(qMax(previousSlot, 0)),
+                                     current.column(), rootIndex());
             break;
         case MoveRight:
         case MoveDown:
-            if (current.row() < rows(current) - 1)
-                current = model()->index(current.row() + 1, current.column(),
-                                         rootIndex());
-            else
-                current = model()->index(rows(current) - 1, current.column(),
-                                         rootIndex());
+            current = model()->index(sliceRows.at(qMin(nextSlot, lastSlot)),
+                                     current.column(), rootIndex());
             break;
         case MoveHome:
-            current = model()->index(0, 1);
+            current = model()->index(sliceRows.first(), 1, rootIndex());
             break;
         case MoveEnd:
-            current = model()->index(rows(current) - 1, 0);
+            current = model()->index(sliceRows.last(), 0, rootIndex());
             break;
         case MovePageUp:
-            current = model()->index(0, current.column());
+            current = model()->index(sliceRows.first(), current.column(), rootIndex());
             break;
         case MovePageDown:
-            current = model()->index(rows(current) - 1, current.column());
+            current = model()->index(sliceRows.last(), current.column(), rootIndex());
             break;
         case MoveNext:      // Tab
         case MovePrevious:  // Backtab
-            current = model()->index(current.row(), 1 - current.column());
+            current = model()->index(current.row(), 1 - current.column(), rootIndex());
             break;
         default:
             break;
     }
 
-    viewport()->update();
     return current;
 }
 
 void PieView::paintEvent(QPaintEvent *event)
 {
-    QItemSelectionModel *selections = selectionModel();
+    QPainter painter(viewport());
+    QRect exposed = event->rect();
+
+    // Everything except selection and focus comes from a cached layer, which
+    // only needs to be redrawn when the data, geometry, palette or font
+    // change. Selected and current items are drawn over the top.
+    updateBaseLayer();
+    qreal ratio = baseLayer.devicePixelRatio();
+    painter.drawPixmap(exposed.topLeft(), baseLayer,
+                       QRect(exposed.topLeft() * ratio, exposed.size() * ratio));
+
+    if (sliceRows.isEmpty())
+        return;
+
+    painter.setRenderHint(QPainter::Antialiasing);
+    QStyleOptionViewItem option = viewOptions();
+    updateWedges();
+
+    // Only the key items in the exposed rectangle need to be looked at, so
+    // painting costs the same however long the key is.
+    QRect contentsRect = exposed.translated(horizontalScrollBar()->value(),
+                                            verticalScrollBar()->value());
+    bool pieExposed = contentsRect.intersects(QRect(margin, margin, pieSize, pieSize));
+    int firstKeySlot = 0;
+    int lastKeySlot = -1;
+    keySlotsIn(contentsRect, &firstKeySlot, &lastKeySlot);
+
+    const QItemSelection selection = selectionModel()->selection();
+    for (const QItemSelectionRange &range : selection) {
+        if (range.parent() != rootIndex())
+            continue;
+
+        int firstSlot = firstSlotFrom(range.top());
+        int endSlot = firstSlotFrom(range.bottom() + 1);
+
+        if (range.left() <= 0 && 0 <= range.right()) {
+            for (int slot = qMax(firstSlot, firstKeySlot);
+                 slot < endSlot && slot <= lastKeySlot; ++slot)
+                paintKeyHighlight(&painter, option, slot);
+        }
+        if (range.left() <= 1 && 1 <= range.right() && pieExposed && firstSlot < endSlot) {
+            int lastWedge = wedgeAt(endSlot - 1);
+            for (int wedge = wedgeAt(firstSlot); wedge <= lastWedge; ++wedge)
+                paintSliceHighlight(&painter, option, wedge);
+        }
+    }
+
+    QModelIndex current = currentIndex();
+    int currentSlot = rowSlots.value(current.row(), -1);
+    if (currentSlot >= 0 && !selectionModel()->isSelected(current)) {
+        if (current.column() == 0 && firstKeySlot <= currentSlot && currentSlot <= lastKeySlot)
+            paintKeyHighlight(&painter, option, currentSlot);
+        else if (current.column() == 1 && pieExposed)
+            paintSliceHighlight(&painter, option, wedgeAt(currentSlot));
+    }
+}
+
+/*
+    Redraws the cached layer that holds the pie and the key as they look
+    when nothing is selected, if it is out of date. Only the key items that
+    are in view are drawn.
+*/
+
+void PieView::updateBaseLayer()
+{
+    qreal ratio = devicePixelRatioF();
+    QSize size = viewport()->size() * ratio;
+
+    if (baseLayerValid && baseLayer.size() == size && baseLayer.devicePixelRatio() == ratio)
+        return;
+
+    baseLayer = QPixmap(size);
+    baseLayer.setDevicePixelRatio(ratio);
+    baseLayerValid = true;
+
+    if (size.isEmpty())
+        return;
+
+    paintBaseLayer(viewport()->rect());
+}
+
+/*
+    Draws the part of the base layer in \a rect, which is in viewport
+    coordinates.
+*/
+
+void PieView::paintBaseLayer(const QRect &rect)
+{
     QStyleOptionViewItem option = viewOptions();
 
     QBrush background = option.palette.base();
     QPen foreground(option.palette.color(QPalette::WindowText));
 
-    QPainter painter(viewport());
+    QPainter painter(&baseLayer);
+    painter.setClipRect(rect);
     painter.setRenderHint(QPainter::Antialiasing);
 
-    painter.fillRect(event->rect(), background);
+    painter.fillRect(rect, background);
     painter.setPen(foreground);
 
-    // Viewport rectangles
+    // Contents rectangles
     QRect pieRect = QRect(margin, margin, pieSize, pieSize);
+    QRect contentsRect = rect.translated(horizontalScrollBar()->value(),
+                                         verticalScrollBar()->value());
 
-    if (validItems <= 0)
+    if (sliceRows.isEmpty())
         return;
 
-    painter.save();
-    painter.translate(pieRect.x() - horizontalScrollBar()->value(),
-                      pieRect.y() - verticalScrollBar()->value());
-    painter.drawEllipse(0, 0, pieSize, pieSize);
-    double startAngle = 0.0;
-    int row;
-
-    for (row = 0; row < model()->rowCount(rootIndex()); ++row) {
-        QModelIndex index = model()->index(row, 1, rootIndex());
-        double value = model()->data(index).toDouble();
+    if (contentsRect.intersects(pieRect)) {
+        updateWedges();
 
-        if (value > 0.0) {
-            double angle = 360 * value / totalValue;
+        painter.save();
+        painter.translate(pieRect.x() - horizontalScrollBar()->value(),
+                          pieRect.y() - verticalScrollBar()->value());
+        painter.drawEllipse(0, 0, pieSize, pieSize);
 
-            QModelIndex colorIndex = model()->index(row, 0, rootIndex());
+        for (const Wedge &wedge : qAsConst(wedges)) {
+            QModelIndex colorIndex = model()->index(sliceRows.at(wedge.colorSlot), 0, rootIndex());
             QColor color = QColor(model()->data(colorIndex, Qt::DecorationRole).toString());
 
-            if (currentIndex() == index)
-                painter.setBrush(QBrush(color, Qt::Dense4Pattern));
-            else if (selections->isSelected(index))
-                painter.setBrush(QBrush(color, Qt::Dense3Pattern));
-            else
-                painter.setBrush(QBrush(color));
+            painter.setBrush(QBrush(color));
+            painter.drawPie(0, 0, pieSize, pieSize, wedgeStart(wedge), wedgeSpan(wedge));
+        }
+        painter.restore();
+    }
+
+    int firstSlot = 0;
+    int lastSlot = -1;
+    keySlotsIn(contentsRect, &firstSlot, &lastSlot);
 
-            painter.drawPie(0, 0, pieSize, pieSize, int(startAngle*16), int(angle*16));
+    for (int slot = firstSlot; slot <= lastSlot; ++slot) {
+        QModelIndex labelIndex = model()->index(sliceRows.at(slot), 0, rootIndex());
 
-            startAngle += angle;
-        }
+        option.rect = visualRect(labelIndex);
+        itemDelegate()->paint(&painter, option, labelIndex);
     }
-    painter.restore();
+}
 
-    int keyNumber = 0;
+/*
+    Draws the key item in \a slot over the top of the base layer to show
+    that it is selected or current.
+*/
 
-    for (row = 0; row < model()->rowCount(rootIndex()); ++row) {
-        QModelIndex index = model()->index(row, 1, rootIndex());
-        double value = model()->data(index).toDouble();
+void PieView::paintKeyHighlight(QPainter *painter, const QStyleOptionViewItem &baseOption,
+                                int slot) const
+{
+    QModelIndex index = model()->index(sliceRows.at(slot), 0, rootIndex());
 
-        if (value > 0.0) {
-            QModelIndex labelIndex = model()->index(row, 0, rootIndex());
+    QStyleOptionViewItem option = baseOption;
+    option.rect = visualRect(index);
+    if (selectionModel()->isSelected(index))
+        option.state |= QStyle::State_Selected;
+    if (currentIndex() == index)
+        option.state |= QStyle::State_HasFocus;
 
-            QStyleOptionViewItem option = viewOptions();
-            option.rect = visualRect(labelIndex);
-            if (selections->isSelected(labelIndex))
-                option.state |= QStyle::State_Selected;
-            if (currentIndex() == labelIndex)
-                option.state |= QStyle::State_HasFocus;
-            itemDelegate()->paint(&painter, option, labelIndex);
+    painter->fillRect(option.rect, option.palette.base());
+    itemDelegate()->paint(painter, option, index);
+}
 
-            ++keyNumber;
-        }
-    }
+/*
+    Draws the wedge at \a index in the wedge table over the top of the base
+    layer to show that it is selected or current.
+*/
+
+void PieView::paintSliceHighlight(QPainter *painter, const QStyleOptionViewItem &baseOption,
+                                  int index) const
+{
+    const Wedge &wedge = wedges.at(index);
+    QModelIndex colorIndex = model()->index(sliceRows.at(wedge.colorSlot), 0, rootIndex());
+    QColor color = QColor(model()->data(colorIndex, Qt::DecorationRole).toString());
+
+    QModelIndex current = currentIndex();
+    int currentSlot = rowSlots.value(current.row(), -1);
+    bool containsCurrent = current.column() == 1
+        && wedge.firstSlot <= currentSlot && currentSlot < wedge.endSlot;
+
+    QRect pieRect = QRect(margin - horizontalScrollBar()->value(),
+                          margin - verticalScrollBar()->value(),
+                          pieSize, pieSize);
+
+    // The patterns are partly transparent, so clear the slice first.
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(baseOption.palette.base());
+    painter->drawPie(pieRect, wedgeStart(wedge), wedgeSpan(wedge));
+
+    Qt::BrushStyle pattern = containsCurrent ? Qt::Dense4Pattern : Qt::Dense3Pattern;
+    painter->setPen(QPen(baseOption.palette.color(QPalette::WindowText)));
+    painter->setBrush(QBrush(color, pattern));
+    painter->drawPie(pieRect, wedgeStart(wedge), wedgeSpan(wedge));
 }
 
-void PieView::resizeEvent(QResizeEvent * /* event */)
+void PieView::reset()
 {
+    rebuildSlots();
+    QAbstractItemView::reset();
     updateGeometries();
 }
 
-int PieView::rows(const QModelIndex &index) const
+void PieView::resizeEvent(QResizeEvent * /* event */)
 {
-    return model()->rowCount(model()->parent(index));
+    baseLayerValid = false;
+    updateGeometries();
 }
 
 void PieView::rowsInserted(const QModelIndex &parent, int start, int end)
 {
-    for (int row = start; row <= end; ++row) {
-        QModelIndex index = model()->index(row, 1, rootIndex());
-        double value = model()->data(index).toDouble();
-
-        if (value > 0.0) {
-            totalValue += value;
-            ++validItems;
-        }
-    }
+    insertSlots(start, end);
+    updateGeometries();
+    viewport()->update();   // every slice after start has moved
 
     QAbstractItemView::rowsInserted(parent, start, end);
 }
 
 void PieView::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
 {
-    for (int row = start; row <= end; ++row) {
-        QModelIndex index = model()->index(row, 1, rootIndex());
-        double value = model()->data(index).toDouble();
-        if (value > 0.0) {
-            totalValue -= value;
-            --validItems;
-        }
-    }
+    removeSlots(start, end);
+    updateGeometries();
+    viewport()->update();
 
     QAbstractItemView::rowsAboutToBeRemoved(parent, start, end);
 }
 
+void PieView::setModel(QAbstractItemModel *model)
+{
+    QAbstractItemView::setModel(model);
+    rebuildSlots();
+    updateGeometries();
+}
+
 void PieView::scrollContentsBy(int dx, int dy)
 {
+    // The base layer is in viewport coordinates, so it is scrolled along with
+    // the viewport and only the strips that come into view are drawn. That
+    // needs whole device pixels, so fractional scale factors redraw it all.
+    const QRect area = viewport()->rect();
+    const qreal ratio = baseLayer.devicePixelRatio();
+    if (baseLayerValid && !baseLayer.isNull() && ratio == std::floor(ratio)
+            && qAbs(dx) < area.width() && qAbs(dy) < area.height()) {
+        baseLayer.scroll(int(dx * ratio), int(dy * ratio), baseLayer.rect());
+
+        QRegion exposed;
+        if (dx > 0)
+            exposed += QRect(0, 0, dx, area.height());
+        else if (dx < 0)
+            exposed += QRect(area.width() + dx, 0, -dx, area.height());
+        if (dy > 0)
+            exposed += QRect(0, 0, area.width(), dy);
+        else if (dy < 0)
+            exposed += QRect(0, area.height() + dy, area.width(), -dy);
+
+        for (const QRect &rect : exposed)
+            paintBaseLayer(rect);
+    } else {
+        baseLayerValid = false;
+    }
+
     viewport()->scroll(dx, dy);
 }
 
@@ -564,51 +736,644 @@ void PieView::setSelection(const QRect &rect, QItemSelectionModel::SelectionFlag
                             horizontalScrollBar()->value(),
                             verticalScrollBar()->value()).normalized();
 
+    const SelectionExtent extent = selectionExtent(contentsRect);
+
+    if (extent.firstRow >= 0) {
+        QItemSelection selection(
+            model()->index(extent.firstRow, extent.firstColumn, rootIndex()),
+            model()->index(extent.lastRow, extent.lastColumn, rootIndex()));
+        selectionModel()->select(selection, command);
+    } else {
+        QModelIndex noIndex;
+        QItemSelection selection(noIndex, noIndex);
+        selectionModel()->select(selection, command);
+    }
+
+    update();
+}
+
+/*
+    Finds the rows and columns of the items that intersect \a rect, which is
+    in contents coordinates. Slots are in the same order as rows, so this
+    only depends on the first and last slots covered in the pie (column 1)
+    and in the key (column 0).
+*/
+
+PieView::SelectionExtent PieView::selectionExtent(const QRect &rect) const
+{
+    SelectionExtent extent;
+    int firstSlot = -1;
+    int lastSlot = -1;
+
+    if (sliceSlotsIn(rect, &firstSlot, &lastSlot)) {
+        extent.firstRow = sliceRows.at(firstSlot);
+        extent.lastRow = sliceRows.at(lastSlot);
+        extent.firstColumn = 1;
+        extent.lastColumn = 1;
+    }
+
+    if (keySlotsIn(rect, &firstSlot, &lastSlot)) {
+        if (extent.firstRow < 0 || sliceRows.at(firstSlot) < extent.firstRow)
+            extent.firstRow = sliceRows.at(firstSlot);
+        extent.lastRow = qMax(extent.lastRow, sliceRows.at(lastSlot));
+        extent.firstColumn = 0;
+        if (extent.lastColumn < 0)
+            extent.lastColumn = 0;
+    }
+
+    return extent;
+}
+
+/*
+    Finds the same as selectionExtent() by testing the region of every item
+    in the model, which is slow but obviously correct.
+*/
+
+PieView::SelectionExtent PieView::scanSelectionExtent(const QRect &rect) const
+{
+    SelectionExtent extent;
     int rows = model()->rowCount(rootIndex());
     int columns = model()->columnCount(rootIndex());
-    QModelIndexList indexes;
 
     for (int row = 0; row < rows; ++row) {
         for (int column = 0; column < columns; ++column) {
             QModelIndex index = model()->index(row, column, rootIndex());
-            QRegion region = itemRegion(index);
-            if (region.intersects(contentsRect))
-                indexes.append(index);
+            if (!itemRegion(index).intersects(rect))
+                continue;
+            if (extent.firstRow < 0) {
+                extent.firstRow = row;
+                extent.firstColumn = column;
+                extent.lastColumn = column;
+            }
+            extent.lastRow = row;
+            extent.firstColumn = qMin(extent.firstColumn, column);
+            extent.lastColumn = qMax(extent.lastColumn, column);
         }
     }
 
-    if (indexes.size() > 0) {
-        int firstRow = indexes.at(0).row();
-        int lastRow = firstRow;
-        int firstColumn = indexes.at(0).column();
-        int lastColumn = firstColumn;
+    return extent;
+}
 
-        for (int i = 1; i < indexes.size(); ++i) {
-            firstRow = qMin(firstRow, indexes.at(i).row());
-            lastRow = qMax(lastRow, indexes.at(i).row());
-            firstColumn = qMin(firstColumn, indexes.at(i).column());
-            lastColumn = qMax(lastColumn, indexes.at(i).column());
+/*
+    Checks the rubber-band selection for \a rectangles random rectangles
+    against scanning every item, and warns about each rectangle for which
+    the results differ. The rectangles are in contents coordinates and range
+    from a few pixels to the whole view, some missing every item. Returns the
+    number that differ.
+*/
+
+int PieView::checkSelection(int rectangles, quint32 seed) const
+{
+    QRandomGenerator random(seed);
+    const int width = 2 * totalSize;
+    const int height = qMax(totalSize, int(QFontMetricsF(viewOptions().font).height()
+                                           * sliceRows.size()) + 2 * margin);
+    int mismatches = 0;
+
+    for (int i = 0; i < rectangles; ++i) {
+        const int maximumSize = i % 2 ? 40 : qMax(width, height);
+        QRect rect(random.bounded(-20, width + 20), random.bounded(-20, height + 20),
+                   random.bounded(1, maximumSize), random.bounded(1, maximumSize));
+
+        const SelectionExtent expected = scanSelectionExtent(rect);
+        const SelectionExtent actual = selectionExtent(rect);
+        if (actual.firstRow != expected.firstRow || actual.lastRow != expected.lastRow
+                || actual.firstColumn != expected.firstColumn
+                || actual.lastColumn != expected.lastColumn) {
+            qWarning("Selection differs for %d,%d %dx%d: rows %d-%d columns %d-%d, "
+                     "expected rows %d-%d columns %d-%d",
+                     rect.x(), rect.y(), rect.width(), rect.height(),
+                     actual.firstRow, actual.lastRow, actual.firstColumn, actual.lastColumn,
+                     expected.firstRow, expected.lastRow,
+                     expected.firstColumn, expected.lastColumn);
+            ++mismatches;
         }
+    }
 
-        QItemSelection selection(
-            model()->index(firstRow, firstColumn, rootIndex()),
-            model()->index(lastRow, lastColumn, rootIndex()));
-        selectionModel()->select(selection, command);
-    } else {
-        QModelIndex noIndex;
-        QItemSelection selection(noIndex, noIndex);
-        selectionModel()->select(selection, command);
+    return mismatches;
+}
+
+/*
+    Finds the first and last slots in the key whose items intersect \a rect,
+    which is in contents coordinates. Key items all have the same height, so
+    the slots can be calculated directly. Rounding means the calculation may
+    be out by one, so we check the items at either end.
+*/
+
+bool PieView::keySlotsIn(const QRect &rect, int *firstSlot, int *lastSlot) const
+{
+    if (sliceRows.isEmpty() || rect.isEmpty())
+        return false;
+
+    const qreal itemHeight = QFontMetricsF(viewOptions().font).height();
+    int last = sliceRows.size() - 1;
+    int first = qBound(0, int(std::floor((rect.top() - margin) / itemHeight)) - 1, last);
+    int end = qBound(0, int(std::ceil((rect.bottom() - margin) / itemHeight)) + 1, last);
+
+    while (first <= end && !keyRect(first, itemHeight).intersects(rect))
+        ++first;
+    while (end >= first && !keyRect(end, itemHeight).intersects(rect))
+        --end;
+
+    if (first > end)
+        return false;
+
+    *firstSlot = first;
+    *lastSlot = end;
+    return true;
+}
+
+/*
+    Finds the first and last slots whose slices intersect \a rect, which is
+    in contents coordinates. Rather than testing every slice, we work out the
+    range of angles covered by the rectangle and look those up in the angle
+    table. Only the slices at either end of the range need to be tested.
+*/
+
+bool PieView::sliceSlotsIn(const QRect &rect, int *firstSlot, int *lastSlot) const
+{
+    if (sliceRows.isEmpty() || rect.isEmpty())
+        return false;
+
+    updateAngles();
+    int last = sliceRows.size() - 1;
+
+    // Slices are polygons rounded to whole pixels, so they can stick out
+    // slightly beyond the circle. Use a larger rectangle to find candidates.
+    QRectF area(rect.adjusted(-2, -2, 2, 2));
+    QRectF pieRect(margin, margin, margin + pieSize, margin + pieSize);
+    QPointF center = pieRect.center();
+    double radius = pieRect.width() / 2;
+
+    // Ranges of candidate slots in ascending order. There are two ranges if
+    // the rectangle straddles the line where the first slice starts.
+    int ranges[2][2] = { { 0, last }, { 0, -1 } };
+    int rangeCount = 1;
+
+    if (!area.contains(center)) {
+        // The part of the circle inside the rectangle is convex and doesn't
+        // contain the center, so the angles it covers lie within 180 degrees
+        // and the extreme angles are found at its corners. These are the
+        // rectangle's corners that lie inside the circle, and the points
+        // where the rectangle's edges cross the circle.
+        double angles[12];
+        int count = 0;
+        auto addPoint = [&](double x, double y) {
+            double angle = qRadiansToDegrees(std::atan2(center.y() - y, x - center.x()));
+            angles[count++] = angle < 0 ? angle + 360 : angle;
+        };
+
+        double xs[2] = { area.left(), area.right() };
+        double ys[2] = { area.top(), area.bottom() };
+        double radius2 = radius * radius;
+
+        for (double x : xs) {
+            for (double y : ys) {
+                if (std::pow(x - center.x(), 2) + std::pow(y - center.y(), 2) <= radius2)
+                    addPoint(x, y);
+            }
+        }
+        for (double x : xs) {
+            double d = radius2 - std::pow(x - center.x(), 2);
+            if (d < 0)
+                continue;
+            for (double y : { center.y() - std::sqrt(d), center.y() + std::sqrt(d) }) {
+                if (area.top() <= y && y <= area.bottom())
+                    addPoint(x, y);
+            }
+        }
+        for (double y : ys) {
+            double d = radius2 - std::pow(y - center.y(), 2);
+            if (d < 0)
+                continue;
+            for (double x : { center.x() - std::sqrt(d), center.x() + std::sqrt(d) }) {
+                if (area.left() <= x && x <= area.right())
+                    addPoint(x, y);
+            }
+        }
+
+        if (count == 0)
+            return false; // the rectangle misses the circle
+
+        // The covered angles are everything outside the largest gap between
+        // neighbouring points, which might be the gap that wraps past zero.
+        std::sort(angles, angles + count);
+        int start = 0;
+        double largestGap = angles[0] + 360 - angles[count - 1];
+        for (int i = 1; i < count; ++i) {
+            if (angles[i] - angles[i - 1] > largestGap) {
+                largestGap = angles[i] - angles[i - 1];
+                start = i;
+            }
+        }
+
+        int fromSlot = qBound(0, sliceAt(angles[start]), last);
+        int toSlot = qBound(0, sliceAt(angles[(start + count - 1) % count]), last);
+
+        if (start == 0) {
+            ranges[0][0] = fromSlot;
+            ranges[0][1] = toSlot;
+        } else if (toSlot < fromSlot) {
+            ranges[0][1] = toSlot;
+            ranges[1][0] = fromSlot;
+            ranges[1][1] = last;
+            rangeCount = 2;
+        }
     }
 
-    update();
+    auto hits = [&](int slot) {
+        return sliceGeometry(slot).region.intersects(rect);
+    };
+
+    int first = -1;
+    for (int range = 0; range < rangeCount && first < 0; ++range) {
+        for (int slot = ranges[range][0]; slot <= ranges[range][1]; ++slot) {
+            if (hits(slot)) {
+                first = slot;
+                break;
+            }
+        }
+    }
+
+    if (first < 0)
+        return false;
+
+    int end = first;
+    for (int range = rangeCount - 1; range >= 0 && end == first; --range) {
+        for (int slot = ranges[range][1]; slot > first && slot >= ranges[range][0]; --slot) {
+            if (hits(slot)) {
+                end = slot;
+                break;
+            }
+        }
+    }
+
+    *firstSlot = first;
+    *lastSlot = end;
+    return true;
 }
 
 void PieView::updateGeometries()
 {
+    // The key has an item for every slice, so it can be much taller than
+    // the pie.
+    const qreal itemHeight = QFontMetricsF(viewOptions().font).height();
+    int contentsHeight = qMax(totalSize, qCeil(margin + sliceRows.size() * itemHeight));
+
     horizontalScrollBar()->setPageStep(viewport()->width());
     horizontalScrollBar()->setRange(0, qMax(0, 2 * totalSize - viewport()->width()));
+    verticalScrollBar()->setSingleStep(qMax(1, qRound(itemHeight)));
     verticalScrollBar()->setPageStep(viewport()->height());
-    verticalScrollBar()->setRange(0, qMax(0, totalSize - viewport()->height()));
+    verticalScrollBar()->setRange(0, qMax(0, contentsHeight - viewport()->height()));
+}
+
+/*
+    Returns the slot of the first slice drawn for \a row or any row after it.
+*/
+
+int PieView::firstSlotFrom(int row) const
+{
+    return int(std::lower_bound(sliceRows.cbegin(), sliceRows.cend(), row)
+               - sliceRows.cbegin());
+}
+
+/*
+    Returns the angle at which \a wedge starts, and the angle that it spans,
+    in the 1/16ths of a degree used by QPainter::drawPie().
+*/
+
+int PieView::wedgeStart(const Wedge &wedge) const
+{
+    return int(sliceAngles.at(wedge.firstSlot) * 16);
+}
+
+int PieView::wedgeSpan(const Wedge &wedge) const
+{
+    return int((sliceAngles.at(wedge.endSlot) - sliceAngles.at(wedge.firstSlot)) * 16);
+}
+
+/*
+    Returns the position in the wedge table of the wedge that contains the
+    slice in \a slot.
+*/
+
+int PieView::wedgeAt(int slot) const
+{
+    updateWedges();
+    auto it = std::upper_bound(wedges.cbegin(), wedges.cend(), slot,
+                               [](int slot, const Wedge &wedge) {
+                                   return slot < wedge.firstSlot;
+                               });
+    return int(it - wedges.cbegin()) - 1;
+}
+
+/*
+    Rebuilds the table of wedges if the layout has changed. Consecutive
+    slices narrower than minimumSliceAngle() are merged into a single wedge,
+    drawn in the color of its largest slice, so that the number of wedges
+    depends on the size of the pie rather than the number of rows. A slice
+    that is wide enough always gets a wedge of its own.
+*/
+
+void PieView::updateWedges() const
+{
+    if (wedgesGeneration == layoutGeneration)
+        return;
+
+    updateAngles();
+    wedges.clear();
+
+    int count = sliceRows.size();
+    int slot = 0;
+
+    while (slot < count) {
+        Wedge wedge;
+        wedge.firstSlot = slot;
+        wedge.colorSlot = slot;
+
+        do {
+            if (rowValues.at(sliceRows.at(slot)) > rowValues.at(sliceRows.at(wedge.colorSlot)))
+                wedge.colorSlot = slot;
+            ++slot;
+        } while (slot < count
+                 && sliceAngles.at(slot) - sliceAngles.at(wedge.firstSlot) < minimumAngle
+                 && sliceAngles.at(slot + 1) - sliceAngles.at(slot) < minimumAngle);
+
+        wedge.endSlot = slot;
+        wedges.append(wedge);
+    }
+
+    wedgesGeneration = layoutGeneration;
+}
+
+/*
+    Sets the angle, in degrees, below which consecutive slices are drawn
+    merged together. Set it to 0 to always draw every slice separately.
+*/
+
+void PieView::setMinimumSliceAngle(qreal degrees)
+{
+    minimumAngle = degrees;
+    invalidateLayout();
+    viewport()->update();
+}
+
+/*
+    Presents the items to screen readers in groups of \a rows consecutive
+    rows, so that a huge chart doesn't expose millions of children at once.
+    Set it to 0 to make every item a child of the view.
+*/
+
+void PieView::setAccessibleGroupSize(int rows)
+{
+    rows = qMax(0, rows);
+    if (rows == groupSize)
+        return;
+    groupSize = rows;
+
+    if (QAccessible::isActive()) {
+        QAccessibleEvent event(this, QAccessible::ObjectReorder);
+        QAccessible::updateAccessibility(&event);
+    }
+}
+
+/*
+    Returns the slot of the slice that covers \a angle. The result is -1 or
+    the number of slices if no slice covers it.
+*/
+
+int PieView::sliceAt(double angle) const
+{
+    updateAngles();
+    auto it = std::upper_bound(sliceAngles.cbegin(), sliceAngles.cend(), angle);
+    return int(it - sliceAngles.cbegin()) - 1;
+}
+
+/*
+    Rebuilds the key slots and the total from scratch, e.g. after the model
+    was reset.
+*/
+
+void PieView::rebuildSlots()
+{
+    rowValues.clear();
+    rowSlots.clear();
+    sliceRows.clear();
+    totalValue = 0.0;
+    changesSinceResync = 0;
+    invalidateLayout();
+
+    if (!model())
+        return;
+
+    int rows = model()->rowCount(rootIndex());
+    rowValues.reserve(rows);
+    rowSlots.reserve(rows);
+
+    for (int row = 0; row < rows; ++row) {
+
+        QModelIndex index = model()->index(row, 1, rootIndex());
+        double value = model()->data(index).toDouble();
+        rowValues.append(value);
+
+        if (value > 0.0) {
+            totalValue += value;
+            rowSlots.append(sliceRows.size());
+            sliceRows.append(row);
+        } else {
+            rowSlots.append(-1);
+        }
+    }
+}
+
+/*
+    Reads the values of the rows from \a start to \a end, which have just
+    been inserted, adds them to the total and gives slots to the ones that
+    are drawn. The slots of the rows that follow them are moved along.
+*/
+
+void PieView::insertSlots(int start, int end)
+{
+    int count = end - start + 1;
+    int firstSlot = firstSlotFrom(start);
+
+    for (int slot = firstSlot; slot < sliceRows.size(); ++slot)
+        sliceRows[slot] += count;
+    rowSlots.insert(start, count, -1);
+    rowValues.insert(start, count, 0.0);
+
+    QVector<int> newRows;
+    for (int row = start; row <= end; ++row) {
+        QModelIndex index = model()->index(row, 1, rootIndex());
+        double value = model()->data(index).toDouble();
+        rowValues[row] = value;
+
+        if (value > 0.0) {
+            totalValue += value;
+            newRows.append(row);
+        }
+    }
+
+    if (!newRows.isEmpty()) {
+        sliceRows.insert(firstSlot, newRows.size(), -1);
+        std::copy(newRows.cbegin(), newRows.cend(), sliceRows.begin() + firstSlot);
+        for (int slot = firstSlot; slot < sliceRows.size(); ++slot)
+            rowSlots[sliceRows.at(slot)] = slot;
+    }
+
+    invalidateLayout();
+    countChanges(count);
+}
+
+/*
+    Subtracts the values of the rows from \a start to \a end, which are about
+    to be removed, from the total and takes their slots away. The slots of
+    the rows that follow them are moved back.
+*/
+
+void PieView::removeSlots(int start, int end)
+{
+    int count = end - start + 1;
+    int firstSlot = firstSlotFrom(start);
+    int endSlot = firstSlotFrom(end + 1);
+
+    for (int slot = firstSlot; slot < endSlot; ++slot)
+        totalValue -= rowValues.at(sliceRows.at(slot));
+
+    sliceRows.remove(firstSlot, endSlot - firstSlot);
+    rowSlots.remove(start, count);
+    rowValues.remove(start, count);
+
+    for (int slot = firstSlot; slot < sliceRows.size(); ++slot) {
+        sliceRows[slot] -= count;
+        rowSlots[sliceRows.at(slot)] = slot;
+    }
+
+    // Don't leave rounding errors behind once everything has gone.
+    if (sliceRows.isEmpty())
+        totalValue = 0.0;
+
+    invalidateLayout();
+
+    // The model still contains the rows, so a resync must wait until later.
+    changesSinceResync += count;
+}
+
+/*
+    Rereads the values of the rows from \a firstRow to \a lastRow, which have
+    changed, and applies the differences to the total. A row gets a slot if
+    its value became positive and loses its slot if its value is no longer
+    positive.
+*/
+
+void PieView::updateSlots(int firstRow, int lastRow)
+{
+    Q_ASSERT(0 <= firstRow && lastRow < rowSlots.size());
+
+    int firstSlot = firstSlotFrom(firstRow);
+    int endSlot = firstSlotFrom(lastRow + 1);
+
+    QVector<int> newRows;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        QModelIndex index = model()->index(row, 1, rootIndex());
+        double value = model()->data(index).toDouble();
+        double oldValue = rowValues.at(row);
+        rowValues[row] = value;
+
+        if (oldValue > 0.0)
+            totalValue -= oldValue;
+        if (value > 0.0) {
+            totalValue += value;
+            newRows.append(row);
+        }
+        rowSlots[row] = -1;
+    }
+
+    int delta = newRows.size() - (endSlot - firstSlot);
+    if (delta > 0)
+        sliceRows.insert(firstSlot, delta, -1);
+    else if (delta < 0)
+        sliceRows.remove(firstSlot, -delta);
+    std::copy(newRows.cbegin(), newRows.cend(), sliceRows.begin() + firstSlot);
+
+    // Rows after the changed range only need new slots if the number of
+    // slices in the range has changed.
+    int endUpdate = delta != 0 ? sliceRows.size() : firstSlot + newRows.size();
+    for (int slot = firstSlot; slot < endUpdate; ++slot)
+        rowSlots[sliceRows.at(slot)] = slot;
+
+    invalidateLayout();
+    countChanges(lastRow - firstRow + 1);
+}
+
+/*
+    Recalculates the total from scratch once roughly as many rows have been
+    changed as there are rows in the model. Between times the total is only
+    adjusted by the differences, which lets rounding errors build up. Doing
+    it this way keeps the cost of each change constant on average.
+*/
+
+void PieView::countChanges(int count)
+{
+    changesSinceResync += count;
+    if (changesSinceResync < qMax(rowValues.size(), 1024))
+        return;
+
+    double total = 0.0;
+    for (double value : qAsConst(rowValues)) {
+        if (value > 0.0)
+            total += value;
+    }
+
+#if !defined(NDEBUG)
+    // Debug build: check that the values we kept still match the model, and
+    // that the total hasn't drifted by more than rounding errors.
+    for (int row = 0; row < rowValues.size(); ++row) {
+        QModelIndex index = model()->index(row, 1, rootIndex());
+        Q_ASSERT(model()->data(index).toDouble() == rowValues.at(row));
+    }
+    Q_ASSERT(qAbs(total - totalValue) <= 1e-6 * qMax(1.0, total));
+#endif
+
+    totalValue = total;
+    changesSinceResync = 0;
+    invalidateLayout();
+}
+
+/*
+    Must be called whenever the position or size of any slice might have
+    changed, i.e. when values, the total, totalSize or margin change.
+*/
+
+void PieView::invalidateLayout()
+{
+    anglesDirty = true;
+    ++layoutGeneration;
+    baseLayerValid = false;
+}
+
+/*
+    Rebuilds the table of slice angles if anything has changed since it was
+    last built. This saves us from walking the model every time we need to
+    know which slice is drawn where.
+*/
+
+void PieView::updateAngles() const
+{
+    if (!anglesDirty)
+        return;
+
+    sliceAngles.clear();
+    sliceAngles.reserve(sliceRows.size() + 1);
+    double startAngle = 0.0;
+
+    for (int row : sliceRows) {
+        sliceAngles.append(startAngle);
+        startAngle += 360 * rowValues.at(row) / totalValue;
+    }
+    sliceAngles.append(startAngle);
+
+    anglesDirty = false;
 }
 
 int PieView::verticalOffset() const
@@ -633,24 +1398,86 @@ QRect PieView::visualRect(const QModelIndex &index) const
 
 /*
     Returns a region corresponding to the selection in viewport coordinates.
+    Only the key items in view are included, and the highlight of a slice
+    covers its whole wedge, so this costs the same however many items are
+    selected. It is the region that paintEvent() draws highlights in.
 */
 
 QRegion PieView::visualRegionForSelection(const QItemSelection &selection) const
 {
-    int ranges = selection.count();
-
-    if (ranges == 0)
-        return QRect();
-
     QRegion region;
-    for (int i = 0; i < ranges; ++i) {
-        const QItemSelectionRange &range = selection.at(i);
-        for (int row = range.top(); row <= range.bottom(); ++row) {
-            for (int col = range.left(); col <= range.right(); ++col) {
-                QModelIndex index = model()->index(row, col, rootIndex());
-                region += visualRect(index);
+    if (sliceRows.isEmpty())
+        return region;
+
+    const int dx = horizontalScrollBar()->value();
+    const int dy = verticalScrollBar()->value();
+    const qreal itemHeight = QFontMetricsF(viewOptions().font).height();
+    int firstKeySlot = 0;
+    int lastKeySlot = -1;
+    keySlotsIn(viewport()->rect().translated(dx, dy), &firstKeySlot, &lastKeySlot);
+
+    for (const QItemSelectionRange &range : selection) {
+        if (!range.isValid() || range.parent() != rootIndex())
+            continue;
+
+        int firstSlot = firstSlotFrom(range.top());
+        int endSlot = firstSlotFrom(range.bottom() + 1);
+
+        if (range.left() <= 0 && 0 <= range.right()) {
+            int first = qMax(firstSlot, firstKeySlot);
+            int last = qMin(endSlot - 1, lastKeySlot);
+            if (first <= last) {
+                region += keyRect(first, itemHeight).united(keyRect(last, itemHeight))
+                              .translated(-dx, -dy);
             }
         }
+        if (range.left() <= 1 && 1 <= range.right())
+            region += sliceHighlightRegion(firstSlot, endSlot);
     }
     return region;
 }
+
+/*
+    Returns the region, in viewport coordinates, in which the highlights of
+    the slices in the slots from \a firstSlot up to \a endSlot are drawn.
+    Highlights cover whole wedges, which for a thin slice is much more than
+    the slice itself. Beyond a few wedges the whole pie is simpler.
+*/
+
+QRegion PieView::sliceHighlightRegion(int firstSlot, int endSlot) const
+{
+    if (firstSlot >= endSlot || firstSlot < 0 || endSlot > sliceRows.size())
+        return QRegion();
+
+    const int firstWedge = wedgeAt(firstSlot);
+    const int lastWedge = wedgeAt(endSlot - 1);
+    if (lastWedge - firstWedge >= 16) {
+        return QRect(margin - horizontalScrollBar()->value(),
+                     margin - verticalScrollBar()->value(),
+                     pieSize, pieSize).adjusted(-2, -2, 2, 2);
+    }
+
+    QRegion region;
+    for (int wedge = firstWedge; wedge <= lastWedge; ++wedge)
+        region += wedgeRect(wedge);
+    return region;
+}
+
+/*
+    Returns the bounding rectangle of the wedge at \a index in the wedge
+    table in viewport coordinates, with room for its outline.
+*/
+
+QRect PieView::wedgeRect(int index) const
+{
+    const Wedge &wedge = wedges.at(index);
+    QRectF pieRect(margin - horizontalScrollBar()->value(),
+                   margin - verticalScrollBar()->value(),
+                   pieSize, pieSize);
+
+    QPainterPath path;
+    path.moveTo(pieRect.center());
+    path.arcTo(pieRect, wedgeStart(wedge) / 16.0, wedgeSpan(wedge) / 16.0);
+    path.closeSubpath();
+    return path.boundingRect().toAlignedRect().adjusted(-2, -2, 2, 2);
+}
@@ -52,6 +52,9 @@
 #define PIEVIEW_H
 
 #include <QAbstractItemView>
+#include <QPixmap>
+
+class AccessibleEventQueue;
 
 //! [0]
 class PieView : public QAbstractItemView
@@ -65,6 +68,19 @@ public:
     void scrollTo(const QModelIndex &index, ScrollHint hint = EnsureVisible) override;
     QModelIndex indexAt(const QPoint &point) const override;
     double total() { return totalValue; }
+    qreal minimumSliceAngle() const { return minimumAngle; }
+    void setMinimumSliceAngle(qreal degrees);
+    int accessibleGroupSize() const { return groupSize; }
+    AccessibleEventQueue *accessibleEventQueue() const { return accessibleEvents; }
+    void setAccessibleGroupSize(int rows);
+    void setModel(QAbstractItemModel *model) override;
+
+    // Compares rubber-band selection with testing every item, see the
+    // --check-selection option.
+    int checkSelection(int rectangles, quint32 seed = 1) const;
+
+public slots:
+    void reset() override;
 
 protected slots:
     void currentChanged(const QModelIndex &current,
@@ -93,6 +109,7 @@ protected:
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
 
+    void changeEvent(QEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
     void scrollContentsBy(int dx, int dy) override;
@@ -102,16 +119,105 @@ protected:
 private:
     QRect itemRect(const QModelIndex &item) const;
     QRegion itemRegion(const QModelIndex &index) const;
-    int rows(const QModelIndex &index = QModelIndex()) const;
+    QRect keyRect(int slot, qreal itemHeight) const;
+    bool keySlotsIn(const QRect &rect, int *firstSlot, int *lastSlot) const;
+    bool sliceSlotsIn(const QRect &rect, int *firstSlot, int *lastSlot) const;
+
+    struct SelectionExtent
+    {
+        int firstRow = -1;      // -1 if no item is covered
+        int lastRow = -1;
+        int firstColumn = -1;
+        int lastColumn = -1;
+    };
+    SelectionExtent selectionExtent(const QRect &rect) const;
+    SelectionExtent scanSelectionExtent(const QRect &rect) const;
+
+    struct SliceGeometry
+    {
+        quint64 generation = 0;
+        QRegion region;
+        QRect bounds;
+    };
+    const SliceGeometry &sliceGeometry(int slot) const;
+
     void updateGeometries() override;
+    int firstSlotFrom(int row) const;
+    int sliceAt(double angle) const;
+
+    struct Wedge
+    {
+        int firstSlot;
+        int endSlot;    // one past the last slot
+        int colorSlot;
+    };
+    int wedgeStart(const Wedge &wedge) const;
+    int wedgeSpan(const Wedge &wedge) const;
+    int wedgeAt(int slot) const;
+    QRect wedgeRect(int index) const;
+    QRegion sliceHighlightRegion(int firstSlot, int endSlot) const;
+    void updateWedges() const;
+
+    void rebuildSlots();
+    void insertSlots(int start, int end);
+    void removeSlots(int start, int end);
+    void updateSlots(int firstRow, int lastRow);
+    void countChanges(int count);
+    void invalidateLayout();
+    void updateAngles() const;
+    void updateBaseLayer();
+    void paintBaseLayer(const QRect &rect);
+    void paintKeyHighlight(QPainter *painter, const QStyleOptionViewItem &baseOption,
+                           int slot) const;
+    void paintSliceHighlight(QPainter *painter, const QStyleOptionViewItem &baseOption,
+                             int index) const;
 
     int margin = 0;
     int totalSize = 300;
     int pieSize = totalSize - 2 * margin;
-    int validItems = 0;
     double totalValue = 0.0;
     QRubberBand *rubberBand = nullptr;
     QPoint origin;
+    AccessibleEventQueue *accessibleEvents;
+
+    // Rows per group in the accessible tree, or 0 to present every item as
+    // a child of the view.
+    int groupSize = 0;
+
+    // The value of each row as it was when we last looked at the model, so
+    // that changes can be applied to the total without a full rescan.
+    QVector<double> rowValues;
+    int changesSinceResync = 0;
+
+    // Each row with a positive value is drawn as a slice and has a slot in
+    // the key. rowSlots maps model rows to slots (or -1 if the row is not
+    // drawn) and sliceRows maps slots back to rows. Both are kept up to date
+    // as rows are inserted, removed and changed.
+    QVector<int> rowSlots;
+    QVector<int> sliceRows;
+
+    // The angle at which each slice starts, plus the angle at which the last
+    // slice ends. Every angle depends on the total, so the table is rebuilt
+    // lazily rather than being updated on every change.
+    mutable QVector<double> sliceAngles;
+    mutable bool anglesDirty = true;
+
+    // Shapes of the slices, indexed by slot. An entry is only valid if its
+    // generation matches layoutGeneration, which changes whenever any slice
+    // might have moved.
+    mutable QVector<SliceGeometry> sliceGeometries;
+    quint64 layoutGeneration = 1;
+
+    // Runs of slices narrower than minimumAngle are drawn as single wedges.
+    // The default is roughly one pixel of the circumference at the default
+    // size.
+    qreal minimumAngle = 0.5;
+    mutable QVector<Wedge> wedges;
+    mutable quint64 wedgesGeneration = 0;
+
+    // The pie and the key with nothing selected, in viewport coordinates.
+    QPixmap baseLayer;
+    bool baseLayerValid = false;
 };
 //! [0]
 